@@ -0,0 +1,370 @@
+#include "command.h"
+#include "registry.h"
+#include "oscillator.h"
+#include "config_internal.h"
+#include "config_store.h"
+#include "dns.h"
+#include "dns_queries.h"
+#include "form_parser.h"
+#include "gesture.h"
+#include "button_traces.h"
+#include "led_engine.h"
+#include "legacy_form.h"
+#include "legacy_dns.h"
+#include "output.h"
+#include "pixels.h"
+#include "state_publisher.h"
+#include "capture_sink.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <thread>
+
+using TClock = std::chrono::steady_clock;
+
+static volatile uint32_t Sink;
+
+static void Report(const char* name, size_t steps, TClock::duration elapsed) {
+    auto ns = std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(steps);
+    printf("%-32s %10.1f ns/step %14.0f steps/s\n", name, ns, 1e9 / ns);
+}
+
+// Runs the function until at least 200 ms have passed, so fast and slow cases are equally stable.
+// stepsPerCall is the number of steps one call of the function makes.
+static void Measure(const char* name, const std::function<uint32_t()>& step, size_t stepsPerCall = 1) {
+    size_t steps = 0;
+    size_t batch = 1024;
+    auto start = TClock::now();
+    TClock::duration elapsed{};
+    uint32_t sink = 0;
+    while (elapsed < std::chrono::milliseconds(200)) {
+        for (size_t i = 0; i < batch; ++i) {
+            sink += step();
+        }
+        steps += batch * stepsPerCall;
+        batch *= 2;
+        elapsed = TClock::now() - start;
+    }
+    Sink = sink;
+    Report(name, steps, elapsed);
+}
+
+static constexpr size_t BlockSize = 32;
+
+template<typename TEffect>
+static void BenchMode(const std::string& name, TEffect effect) {
+    TMode<TEffect> mode(std::move(effect));
+    mode.seed(42);
+    Measure(name.c_str(), [&] {
+        return LevelToDuty(mode.step(), 1000);
+    });
+    std::array<TLevel, BlockSize> block;
+    Measure((name + " (block)").c_str(), [&] {
+        mode.render(block.data(), block.size());
+        uint32_t sum = 0;
+        for (auto level : block) {
+            sum += LevelToDuty(level, 1000);
+        }
+        return sum;
+    }, BlockSize);
+}
+
+static constexpr size_t StripLength = 300;
+
+// One frame of the strip: rendering and WS2812 encoding, the I2S DMA does the rest on the device
+static void BenchPixels(const std::string& name, size_t mode) {
+    auto effect = CreatePixelEffect(mode, StripLength);
+    effect->seed(42);
+    std::vector<TPixel> frame(StripLength);
+    TCaptureSink sink;
+    Measure((name + " x300 (frame)").c_str(), [&] {
+        effect->render(frame.data(), frame.size());
+        sink.Show(frame.data(), frame.size());
+        return static_cast<uint32_t>(frame[0].R);
+    });
+}
+
+// The real PixelTask paced by its own frame period. The task never stops, so the sink outlives the benchmark.
+static void BenchPixelTask() {
+    static TCaptureSink sink;
+    PixelInit(&sink, StripLength);
+    PixelSet(true, 3);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    printf("%-32s %10u frames/s\n", "PixelTask x300", sink.Frames());
+}
+
+class TNullOutputCallback : public IOutputCallback {
+public:
+    void OnOutputChanged(size_t, bool, size_t) override {
+    }
+
+    void OnOutputReport(const TOutputReport&) override {
+    }
+
+    void OnOutputSave(const TOutputSnapshot&) override {
+    }
+
+    void OnOutputIdle(bool idle) override {
+        Idle = idle;
+    }
+
+    std::atomic<bool> Idle{false};
+};
+
+static uint32_t Total(const TWakeCounts& counts) {
+    uint32_t total = 0;
+    for (auto count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+// Runs the real OutputTask with the candle on all channels while commands keep arriving,
+// then for a second with the static mode, when the frames stop
+static void BenchOutputTask() {
+    static TNullOutputCallback callback;
+    OutputInit(&callback);
+    OutputSet(EOutputState::On);
+    auto start = OutputGetStats();
+    NWakeups::Take();
+    for (int i = 0; i < 100; ++i) {
+        TCommand command;
+        command.State = EOutputState::Mode;
+        command.Mode = static_cast<uint8_t>(FindMode(i % 2 ? "candle" : "fireplace"));
+        OutputSet(command);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto stats = OutputGetStats();
+    auto active = NWakeups::Take();
+    printf("%-32s %10u frames/s %6u missed %6u underruns\n", "OutputTask",
+           stats.Frames - start.Frames, stats.MissedDeadlines - start.MissedDeadlines, stats.Underruns - start.Underruns);
+
+    TCommand command;
+    command.State = EOutputState::Mode;
+    command.Mode = static_cast<uint8_t>(FindMode("static"));
+    OutputSet(command);
+    // The crossfade ends and the last frames leave the ring
+    std::this_thread::sleep_for(std::chrono::milliseconds(CONFIG_OUTPUT_FADE_MS + 200));
+    NWakeups::Take();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    auto idle = NWakeups::Take();
+    printf("%-32s %10u wake-ups/s %6u when static%s\n", "OutputTask", Total(active), Total(idle),
+           callback.Idle ? ", idle" : "");
+}
+
+// A mode preview over the steady connecting indication, then a second of the steady one alone
+static void BenchLedEngine() {
+    static std::atomic<uint32_t> edges{0};
+    static std::atomic<bool> level{false};
+    static TLedEngine engine([](void*, bool on) {
+        if (level.exchange(on) != on) {
+            ++edges;
+        }
+    }, nullptr);
+    static constexpr auto preview = TLedPattern::FromBits(ModeInfos[FindMode("candle")].LedPattern, 100, false);
+    engine.Init();
+    engine.Show(ELedIndication::Connecting, &LedSteadyOn);
+    NWakeups::Take();
+    engine.Show(ELedIndication::ModePreview, &preview);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1700));
+    auto previewWakeups = NWakeups::Take()[static_cast<size_t>(EWakeSource::Led)];
+    auto shown = engine.Shown();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    auto steadyWakeups = NWakeups::Take()[static_cast<size_t>(EWakeSource::Led)];
+    printf("%-32s %10u wake-ups %6u edges %6u when steady%s\n", "TLedEngine preview", previewWakeups, edges.load(),
+           steadyWakeups, shown == ELedIndication::Connecting && level ? ", back to connecting" : "");
+}
+
+// Replays the recorded edges through the recognizer, the click latency is from the raw release
+static bool ReplayButtonTraces() {
+    struct TRecord {
+        std::string Gestures;
+        uint32_t Steps = 0;
+        int64_t LastEventUs = 0;
+    };
+    static constexpr std::array<const char*, 8> names = {
+        "click", "double", "hold", "step", "end", "reset-begin", "reset-end", "reset",
+    };
+    bool ok = true;
+    for (const auto& trace : ButtonTraces()) {
+        TRecord record;
+        TGestureRecognizer recognizer([](void* arg, EGesture gesture, int64_t timeUs) {
+            auto record = static_cast<TRecord*>(arg);
+            record->LastEventUs = timeUs;
+            if (gesture == EGesture::HoldStep) {
+                ++record->Steps;
+                return;
+            }
+            if (!record->Gestures.empty()) {
+                record->Gestures += ' ';
+            }
+            record->Gestures += names[static_cast<size_t>(gesture)];
+        }, &record);
+        auto deadline = TGestureRecognizer::NoDeadline;
+        for (auto [pressed, timeUs] : trace.Edges) {
+            while (deadline <= timeUs) {
+                deadline = recognizer.Advance(deadline);
+            }
+            recognizer.Edge(pressed, timeUs);
+            deadline = recognizer.Advance(timeUs);
+        }
+        while (deadline != TGestureRecognizer::NoDeadline) {
+            deadline = recognizer.Advance(deadline);
+        }
+        int64_t releasedAtUs = 0;
+        for (auto [pressed, timeUs] : trace.Edges) {
+            if (!pressed && timeUs <= record.LastEventUs) {
+                releasedAtUs = timeUs;
+            }
+        }
+        bool match = record.Gestures == trace.Expected && record.Steps == trace.Steps;
+        ok = ok && match;
+        printf("%-32s %10s %6u steps %6lld us after the release%s\n", ("Gestures " + std::string(trace.Name)).c_str(),
+               record.Gestures.empty() ? "-" : record.Gestures.c_str(), record.Steps,
+               static_cast<long long>(record.Gestures.empty() ? 0 : record.LastEventUs - releasedAtUs),
+               match ? "" : ", MISMATCH");
+    }
+    return ok;
+}
+
+// Cycles the modes like a user holding the button: 18 changes 100 ms apart
+static void BenchStatePublisher() {
+    static std::atomic<uint32_t> lastMode{0};
+    static std::atomic<int64_t> lastAt{0};
+    static TStatePublisher publisher(CONFIG_STATE_PUBLISH_INTERVAL_MS, [](void*, size_t, bool, uint8_t mode) {
+        lastMode = mode;
+        lastAt = esp_timer_get_time();
+        return true;
+    }, nullptr);
+    publisher.Start();
+    constexpr uint32_t Changes = 18;
+    int64_t finalAt = 0;
+    for (uint32_t i = 0; i < Changes; ++i) {
+        finalAt = esp_timer_get_time();
+        publisher.Update(0, true, i % ModeCount);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(CONFIG_STATE_PUBLISH_INTERVAL_MS));
+    bool latest = lastMode == (Changes - 1) % ModeCount;
+    printf("%-32s %10u changes %6u published %6u suppressed, final state %s after %lld ms\n", "StatePublisher",
+           Changes, publisher.Published(), publisher.Suppressed(), latest ? "sent" : "LOST",
+           static_cast<long long>((lastAt - finalAt) / 1000));
+}
+
+static std::string ReadFile(const char* path) {
+    std::ifstream stream(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+}
+
+int main() {
+#ifdef CONFIG_MODES_FIXED_POINT
+    printf("Effect engine: fixed point Q8.24\n");
+#else
+    printf("Effect engine: double\n");
+#endif
+    BenchMode("Static", Static{});
+    BenchMode("Dynamic", Dynamic(1000, EWaveform::Sine));
+    BenchMode("Dynamic (triangle)", Dynamic(1000, EWaveform::Triangle));
+    BenchMode("Dynamic (ease)", Dynamic(1000, EWaveform::Ease));
+    BenchMode("Dynamic (sawtooth)", Dynamic(1000, EWaveform::Sawtooth));
+    BenchMode("Fireplace", Fireplace{});
+    BenchMode("Candle", Candle{});
+
+    BenchPixels("Pixels Static", 0);
+    BenchPixels("Pixels Dynamic", 1);
+    BenchPixels("Pixels Fireplace", 2);
+    BenchPixels("Pixels Candle", 3);
+    BenchPixelTask();
+    BenchOutputTask();
+    BenchLedEngine();
+    if (!ReplayButtonTraces()) {
+        return 1;
+    }
+    BenchStatePublisher();
+
+    Measure("ParseCommand (word)", [] {
+        TCommand command;
+        return static_cast<uint32_t>(ParseCommand("fireplace", command));
+    });
+    Measure("ParseCommand (scene)", [] {
+        TCommand command;
+        ParseCommand("mode=candle;brightness=40;speed=1.5;fade=800", command);
+        return static_cast<uint32_t>(*command.Speed + *command.Brightness);
+    });
+
+    TStorage storage;
+    storage.Init("config");
+    TConfigStore config(&storage);
+    auto transaction = config.Begin();
+    if (!transaction.SetString(EConfigKey::Ssid, "Home Network #2")
+        || !transaction.SetString(EConfigKey::Password, "p@ssw0rd!?&more")
+        || !transaction.Commit()) {
+        printf("TConfigStore: commit failed\n");
+        return 1;
+    }
+    Measure("TStorage::Get (ssid)", [&] {
+        return static_cast<uint32_t>(storage.Get("ssid").size());
+    });
+    Measure("TConfigStore::GetString (ssid)", [&] {
+        return static_cast<uint32_t>(config.GetString(EConfigKey::Ssid).size());
+    });
+
+    auto login = ReadFile(LOGIN_HTML);
+    Measure("ProcessTemplate", [&] {
+        auto result = NInternal::ProcessTemplate(login, [](std::string_view key) -> std::string {
+            if (key == "SSID") {
+                return NInternal::EncodeHtml("Home <Network> & \"Guests\"");
+            }
+            return {};
+        });
+        return static_cast<uint32_t>(result.size());
+    });
+
+    std::string_view text = "Tom's \"garland\" <on> & <off> in the living room";
+    Measure("EncodeHtml", [&] {
+        return static_cast<uint32_t>(NInternal::EncodeHtml(text).size());
+    });
+
+    std::string_view form = "ssid=Home%20Network%20%232&password=p%40ssw0rd%21%3F%26more";
+    Measure("ReadUrlEncoded (legacy)", [&] {
+        auto values = NLegacy::ReadUrlEncoded(form.begin(), form.end());
+        return static_cast<uint32_t>(values.size());
+    });
+    Measure("TFormParser", [&] {
+        std::array<char, 32> ssid;
+        std::array<char, 64> password;
+        std::array<TFormField, 2> fields = {{
+            {"ssid", ssid.data(), ssid.size()},
+            {"password", password.data(), password.size()},
+        }};
+        TFormParser parser(fields.data(), fields.size());
+        parser.Feed(form);
+        parser.Finish();
+        return static_cast<uint32_t>(fields[0].Size + fields[1].Size);
+    });
+
+    auto queries = DnsQueries();
+    size_t query = 0;
+    Measure("DNS reply (legacy)", [&] {
+        auto& input = queries[query++ % queries.size()];
+        char request[128];
+        char reply[256];
+        memcpy(request, input.data(), input.size());
+        request[input.size()] = 0;
+        return static_cast<uint32_t>(LegacyParseDnsRequest(request, input.size(), reply, sizeof(reply)));
+    });
+    Measure("DNS reply", [&] {
+        auto& input = queries[query++ % queries.size()];
+        uint8_t packet[NDns::MaxPacket];
+        memcpy(packet, input.data(), input.size());
+        return static_cast<uint32_t>(NDns::BuildReply(packet, input.size(), sizeof(packet), 0x0104a8c0));
+    });
+    return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Raw edges of the button in microseconds, with the bounces of a real tactile switch
+struct TButtonTrace {
+    std::string_view Name;
+    std::vector<std::pair<bool, int64_t>> Edges;
+    // The gestures the trace must give in their order, without the steps of the ramp
+    std::string_view Expected;
+    uint32_t Steps = 0;
+};
+
+inline std::vector<TButtonTrace> ButtonTraces() {
+    return {
+        {"click", {{true, 0}, {false, 180000}}, "click"},
+        {"bouncy click", {
+            {true, 0}, {false, 400}, {true, 900}, {false, 1300}, {true, 2100},
+            {false, 150000}, {true, 150600}, {false, 151200}, {true, 151500}, {false, 152800},
+        }, "click"},
+        {"glitch", {{true, 0}, {false, 800}}, ""},
+        {"double click", {
+            {true, 0}, {false, 120000}, {true, 120500}, {false, 121000},
+            {true, 330000}, {false, 460000},
+        }, "click double"},
+        {"two clicks", {{true, 0}, {false, 120000}, {true, 600000}, {false, 720000}}, "click click"},
+        {"hold", {{true, 0}, {false, 800000}}, "hold end", 7},
+        {"reset", {{true, 0}, {false, 10000000}}, "hold reset-begin end reset", 191},
+        {"too long for reset", {{true, 0}, {false, 13000000}}, "hold reset-begin reset-end end", 251},
+    };
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "pixels.h"
+#include "ws2812.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Simulated strip: encodes every frame like the I2S sink does and keeps the last one
+class TCaptureSink : public IPixelSink {
+public:
+    void Show(const TPixel* frame, size_t count) override {
+        std::lock_guard lock(Lock_);
+        Encoded_.resize(NWs2812::EncodedSize(count) / sizeof(uint16_t));
+        NWs2812::Encode(frame, count, Encoded_.data());
+        Last_.assign(frame, frame + count);
+        ++Frames_;
+    }
+
+    [[nodiscard]] uint32_t Frames() const {
+        return Frames_;
+    }
+
+    [[nodiscard]] std::vector<TPixel> Last() const {
+        std::lock_guard lock(Lock_);
+        return Last_;
+    }
+
+private:
+    mutable std::mutex Lock_;
+    std::vector<uint16_t> Encoded_;
+    std::vector<TPixel> Last_;
+    std::atomic<uint32_t> Frames_{0};
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Queries like the captive portal probes of the phones send them
+inline std::vector<std::vector<uint8_t>> DnsQueries() {
+    auto query = [](uint16_t id, const char* name, uint16_t type) {
+        std::vector<uint8_t> packet = {
+            static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id), 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        };
+        const char* label = name;
+        while (*label != 0) {
+            const char* end = label;
+            while (*end != 0 && *end != '.') {
+                ++end;
+            }
+            packet.push_back(static_cast<uint8_t>(end - label));
+            packet.insert(packet.end(), label, end);
+            label = *end == '.' ? end + 1 : end;
+        }
+        packet.insert(packet.end(), {0x00, static_cast<uint8_t>(type >> 8), static_cast<uint8_t>(type), 0x00, 0x01});
+        return packet;
+    };
+    return {
+        query(0x1234, "connectivitycheck.gstatic.com", 1),
+        query(0x2345, "captive.apple.com", 1),
+        query(0x3456, "www.msftconnecttest.com", 1),
+        query(0x4567, "clients3.google.com", 28),
+    };
+}
@@ -0,0 +1,56 @@
+// Feeds NDns::BuildReply with mutated and random packets. Built with the address and the undefined
+// behavior sanitizers, any read or write out of the packet stops it.
+//
+//   build-host/fuzz_dns [iterations]
+#include "dns.h"
+#include "dns_queries.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    auto seeds = DnsQueries();
+    std::mt19937 gen(42);
+    size_t answered = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        std::vector<uint8_t> input;
+        if (i % 4 == 0) {
+            input.resize(gen() % (NDns::MaxPacket + 1));
+            for (auto& byte : input) {
+                byte = static_cast<uint8_t>(gen());
+            }
+            // Valid standard query header, so the random bytes reach the question parser
+            if (input.size() >= 4) {
+                input[2] = 0x01;
+                input[3] = 0x00;
+            }
+        } else {
+            input = seeds[gen() % seeds.size()];
+            for (size_t flips = gen() % 8; flips > 0; --flips) {
+                input[gen() % input.size()] = static_cast<uint8_t>(gen());
+            }
+            if (gen() % 4 == 0) {
+                input.resize(gen() % (input.size() + 1));
+            }
+        }
+        // Exactly the capacity, so the sanitizer sees every byte past it
+        size_t capacity = input.size() + gen() % 64;
+        auto packet = std::make_unique<uint8_t[]>(capacity);
+        std::copy(input.begin(), input.end(), packet.get());
+        size_t length = NDns::BuildReply(packet.get(), input.size(), capacity, 0x0104a8c0);
+        if (length > capacity) {
+            printf("reply of %zu bytes in a buffer of %zu\n", length, capacity);
+            return 1;
+        }
+        if (length != 0) {
+            ++answered;
+        }
+    }
+    printf("%zu packets, %zu answered, no errors\n", iterations, answered);
+    return 0;
+}
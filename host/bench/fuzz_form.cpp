@@ -0,0 +1,109 @@
+// Feeds TFormParser with random forms split into random chunks and checks the values against a
+// plain decoder written after the URL standard. Built with the address and the undefined behavior
+// sanitizers, any write past a field buffer stops it.
+//
+//   build-host/fuzz_form [iterations]
+#include "form_parser.h"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct TExpected {
+    bool Found = false;
+    std::string Value;
+};
+
+// Splits at '&' and '=', then decodes '+' and the valid %XX escapes of both parts
+static std::string Decode(std::string_view text) {
+    auto hex = [](char ch) {
+        return std::string_view("0123456789abcdefABCDEF").find(ch) != std::string_view::npos;
+    };
+    std::string result;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '+') {
+            result += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() && hex(text[i + 1]) && hex(text[i + 2])) {
+            result += static_cast<char>(std::stoi(std::string(text.substr(i + 1, 2)), nullptr, 16));
+            i += 2;
+        } else {
+            result += text[i];
+        }
+    }
+    return result;
+}
+
+static TExpected Expect(std::string_view form, std::string_view name) {
+    TExpected expected;
+    while (!form.empty()) {
+        auto end = form.find('&');
+        auto pair = form.substr(0, end);
+        form = end == std::string_view::npos ? std::string_view() : form.substr(end + 1);
+        if (pair.empty()) {
+            continue;
+        }
+        auto equals = pair.find('=');
+        auto key = Decode(pair.substr(0, equals));
+        if (key == name && !expected.Found) {
+            expected.Found = true;
+            expected.Value = equals == std::string_view::npos ? std::string() : Decode(pair.substr(equals + 1));
+        }
+    }
+    return expected;
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    constexpr std::string_view Alphabet = "%%%++&&==aAfF09gxs";
+    constexpr std::array<std::string_view, 4> Words = {"ssid", "password", "s%73id", "pass+word"};
+    constexpr std::array<std::string_view, 3> Names = {"ssid", "password", "a b"};
+    constexpr std::array<size_t, 3> Capacities = {8, 4, 32};
+    std::mt19937 gen(42);
+    size_t found = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        std::string form;
+        for (size_t parts = gen() % 12; parts > 0; --parts) {
+            if (gen() % 3 == 0) {
+                form += Words[gen() % Words.size()];
+            } else {
+                form += Alphabet[gen() % Alphabet.size()];
+            }
+        }
+
+        // Exactly the capacity, so the sanitizer sees every byte past it
+        std::array<std::unique_ptr<char[]>, Names.size()> buffers;
+        std::array<TFormField, Names.size()> fields;
+        for (size_t f = 0; f < fields.size(); ++f) {
+            buffers[f] = std::make_unique<char[]>(Capacities[f]);
+            fields[f] = {Names[f], buffers[f].get(), Capacities[f]};
+        }
+        TFormParser parser(fields.data(), fields.size());
+        std::string_view rest = form;
+        while (!rest.empty()) {
+            size_t size = 1 + gen() % rest.size();
+            parser.Feed(rest.substr(0, size));
+            rest.remove_prefix(size);
+        }
+        parser.Finish();
+
+        for (size_t f = 0; f < fields.size(); ++f) {
+            auto expected = Expect(form, Names[f]);
+            auto value = expected.Value.substr(0, Capacities[f]);
+            bool truncated = expected.Value.size() > Capacities[f];
+            if (fields[f].Found != expected.Found
+                || (expected.Found && (fields[f].Value() != value || fields[f].Truncated != truncated))) {
+                printf("'%s': %.*s is '%.*s', expected '%s'\n", form.c_str(), static_cast<int>(Names[f].size()), Names[f].data(),
+                       static_cast<int>(fields[f].Size), fields[f].Data, expected.Value.c_str());
+                return 1;
+            }
+            found += expected.Found;
+        }
+    }
+    printf("%zu forms, %zu values found, no errors\n", iterations, found);
+    return 0;
+}
@@ -0,0 +1,151 @@
+// The DNS reply path of captive.cpp before the rework, kept only to compare with NDns::BuildReply.
+// The ESP_LOGI lines are formatted into a buffer like the logger does, the UART time is not counted.
+#include "legacy_dns.h"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+
+#define OPCODE_MASK (0x7800)
+#define QR_FLAG (1 << 7)
+#define QD_TYPE_A (0x0001)
+#define ANS_TTL_SEC (300)
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ipaddr) ((ipaddr) & 0xff), (((ipaddr) >> 8) & 0xff), (((ipaddr) >> 16) & 0xff), (((ipaddr) >> 24) & 0xff)
+
+static char LogLine[256];
+#define ESP_LOGI(tag, format, ...) snprintf(LogLine, sizeof(LogLine), "I %s: " format, tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...) snprintf(LogLine, sizeof(LogLine), "E %s: " format, tag, ##__VA_ARGS__)
+
+static const char *TAG = "example_dns_redirect_server";
+
+// Stands for tcpip_adapter_get_ip_info(), which the old code called for every answer
+static volatile uint32_t ApAddress = 0x0104a8c0;
+
+// DNS Header Packet
+typedef struct __attribute__((__packed__)) {
+    uint16_t id;
+    uint16_t flags;
+    uint16_t qd_count;
+    uint16_t an_count;
+    uint16_t ns_count;
+    uint16_t ar_count;
+} dns_header_t;
+
+// DNS Question Packet
+typedef struct {
+    uint16_t type;
+    uint16_t class_;
+} dns_question_t;
+
+// DNS Answer Packet
+typedef struct __attribute__((__packed__))
+{
+    uint16_t ptr_offset;
+    uint16_t type;
+    uint16_t class_;
+    uint32_t ttl;
+    uint16_t addr_len;
+    uint32_t ip_addr;
+} dns_answer_t;
+
+/*
+    Parse the name from the packet from the DNS name format to a regular .-seperated name
+    returns the pointer to the next part of the packet
+*/
+static char *parse_dns_name(char *raw_name, char *parsed_name, size_t parsed_name_max_len)
+{
+
+    char *label = raw_name;
+    char *name_itr = parsed_name;
+    int name_len = 0;
+
+    do {
+        int sub_name_len = *label;
+        // (len + 1) since we are adding  a '.'
+        name_len += (sub_name_len + 1);
+        if (name_len > (int)parsed_name_max_len) {
+            return NULL;
+        }
+
+        // Copy the sub name that follows the the label
+        memcpy(name_itr, label + 1, sub_name_len);
+        name_itr[sub_name_len] = '.';
+        name_itr += (sub_name_len + 1);
+        label += sub_name_len + 1;
+    } while (*label != 0);
+
+    // Terminate the final string, replacing the last '.'
+    parsed_name[name_len - 1] = '\0';
+    // Return pointer to first char after the name
+    return label + 1;
+}
+
+// Parses the DNS request and prepares a DNS response with the IP of the softAP
+int LegacyParseDnsRequest(char *req, size_t req_len, char *dns_reply, size_t dns_reply_max_len) {
+    if (req_len > dns_reply_max_len) {
+        return -1;
+    }
+
+    // Prepare the reply
+    memset(dns_reply, 0, dns_reply_max_len);
+    memcpy(dns_reply, req, req_len);
+
+    // Endianess of NW packet different from chip
+    auto header = reinterpret_cast<dns_header_t *>(dns_reply);
+    ESP_LOGI(TAG, "DNS query with header id: 0x%X, flags: 0x%X, qd_count: %d",
+             ntohs(header->id), ntohs(header->flags), ntohs(header->qd_count));
+
+    // Not a standard query
+    if ((header->flags & OPCODE_MASK) != 0) {
+        return 0;
+    }
+
+    // Set question response flag
+    header->flags |= QR_FLAG;
+
+    uint16_t qd_count = ntohs(header->qd_count);
+    header->an_count = htons(qd_count);
+
+    int reply_len = qd_count * sizeof(dns_answer_t) + req_len;
+    if (reply_len > (int)dns_reply_max_len) {
+        return -1;
+    }
+
+    // Pointer to current answer and question
+    char *cur_ans_ptr = dns_reply + req_len;
+    char *cur_qd_ptr = dns_reply + sizeof(dns_header_t);
+    char name[128];
+
+    // Respond to all questions with the ESP32's IP address
+    for (int i = 0; i < qd_count; i++) {
+        const char *name_end_ptr = parse_dns_name(cur_qd_ptr, name, sizeof(name));
+        if (name_end_ptr == nullptr) {
+            ESP_LOGE(TAG, "Failed to parse DNS question: %s", cur_qd_ptr);
+            return -1;
+        }
+
+        dns_question_t question;
+        memcpy(&question, name_end_ptr, sizeof(question));
+        uint16_t qd_type = ntohs(question.type);
+        uint16_t qd_class = ntohs(question.class_);
+
+        ESP_LOGI(TAG, "Received type: %d | Class: %d | Question for: %s", qd_type, qd_class, name);
+
+        if (qd_type == QD_TYPE_A) {
+            auto *answer = reinterpret_cast<dns_answer_t *>(cur_ans_ptr);
+
+            answer->ptr_offset = htons(0xC000 | (cur_qd_ptr - dns_reply));
+            answer->type = htons(qd_type);
+            answer->class_ = htons(qd_class);
+            answer->ttl = htonl(ANS_TTL_SEC);
+
+            uint32_t ip = ApAddress;
+            ESP_LOGI(TAG, "Answer with PTR offset: 0x%X and IP " IPSTR, ntohs(answer->ptr_offset), IP2STR(ip));
+
+            answer->addr_len = htons(sizeof(ip));
+            answer->ip_addr = ip;
+        }
+    }
+    return reply_len;
+}
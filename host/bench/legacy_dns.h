@@ -0,0 +1,5 @@
+#pragma once
+#include <cstddef>
+
+// parse_dns_request() of captive.cpp before the rework
+int LegacyParseDnsRequest(char *req, size_t req_len, char *dns_reply, size_t dns_reply_max_len);
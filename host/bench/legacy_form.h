@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+
+// NInternal::ReadUrlEncoded() of config_internal.h before TFormParser, kept only to compare with it
+namespace NLegacy {
+    template<typename TIterator>
+    std::unordered_map<std::string, std::string> ReadUrlEncoded(TIterator begin, TIterator end) {
+        std::unordered_map<std::string, std::string> result;
+        bool percentMode = false;
+        std::string percentValue;
+        std::string key;
+        std::string value;
+        bool keyMode = true;
+        for (auto ch = begin; ch != end; ++ch) {
+            if (keyMode && *ch == '=') {
+                keyMode = false;
+            } else if (keyMode) {
+                key += *ch;
+            } else if (percentMode) {
+                percentValue += *ch;
+                if (percentValue.size() == 2) {
+                    value += static_cast<char>(std::stoul(percentValue, nullptr, 16));
+                    percentValue.clear();
+                    percentMode = false;
+                }
+            } else if (*ch == '%') {
+                percentMode = true;
+            } else if (*ch == '&') {
+                keyMode = true;
+                result.emplace(key, value);
+                key.clear();
+                value.clear();
+            } else {
+                value += *ch;
+            }
+        }
+        if (!key.empty()) {
+            result.emplace(key, value);
+        }
+        return result;
+    }
+}
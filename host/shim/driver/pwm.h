@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include "esp_err.h"
+
+esp_err_t pwm_init(uint32_t period, uint32_t *duties, uint8_t channel_num, const uint32_t *pin_num);
+esp_err_t pwm_set_duty(uint8_t channel_num, uint32_t duty);
+esp_err_t pwm_get_duty(uint8_t channel_num, uint32_t *duty_p);
+esp_err_t pwm_set_phase(uint8_t channel_num, float phase);
+esp_err_t pwm_set_phases(float *phases);
+esp_err_t pwm_start();
+esp_err_t pwm_stop(uint32_t stop_level_mask);
+
+// Host only: number of pwm_start calls, to check how often the output is reloaded
+uint32_t pwm_host_start_count();
@@ -0,0 +1,87 @@
+#include "esp_system.h"
+#include "esp_task_wdt.h"
+#include "driver/gpio.h"
+#include "driver/pwm.h"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <random>
+
+uint32_t esp_random() {
+    static std::random_device device;
+    return device();
+}
+
+void esp_restart() {
+    exit(0);
+}
+
+uint32_t esp_get_free_heap_size() {
+    return 0;
+}
+
+extern "C" void esp_task_wdt_reset(void) {
+}
+
+static std::array<std::atomic<uint32_t>, 17> GpioLevels{};
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    GpioLevels[gpio_num] = level;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    return static_cast<int>(GpioLevels[gpio_num].load());
+}
+
+static constexpr size_t PwmChannels = 8;
+static std::array<std::atomic<uint32_t>, PwmChannels> PwmDuties{};
+static std::atomic<uint32_t> PwmStarts{0};
+
+esp_err_t pwm_init(uint32_t, uint32_t *duties, uint8_t channel_num, const uint32_t *) {
+    if (channel_num > PwmChannels) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint8_t i = 0; i < channel_num; ++i) {
+        PwmDuties[i] = duties[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t pwm_set_duty(uint8_t channel_num, uint32_t duty) {
+    if (channel_num >= PwmChannels) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    PwmDuties[channel_num] = duty;
+    return ESP_OK;
+}
+
+esp_err_t pwm_get_duty(uint8_t channel_num, uint32_t *duty_p) {
+    if (channel_num >= PwmChannels) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *duty_p = PwmDuties[channel_num];
+    return ESP_OK;
+}
+
+esp_err_t pwm_set_phase(uint8_t channel_num, float) {
+    return channel_num < PwmChannels ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pwm_set_phases(float*) {
+    return ESP_OK;
+}
+
+esp_err_t pwm_start() {
+    ++PwmStarts;
+    return ESP_OK;
+}
+
+esp_err_t pwm_stop(uint32_t) {
+    return ESP_OK;
+}
+
+uint32_t pwm_host_start_count() {
+    return PwmStarts;
+}
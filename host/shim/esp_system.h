@@ -0,0 +1,7 @@
+#pragma once
+#include <cstdint>
+#include "esp_err.h"
+
+uint32_t esp_random();
+void esp_restart();
+uint32_t esp_get_free_heap_size();
@@ -0,0 +1,11 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_task_wdt_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
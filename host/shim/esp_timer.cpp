@@ -0,0 +1,91 @@
+#include "esp_timer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using TClock = std::chrono::steady_clock;
+
+static const TClock::time_point Boot = TClock::now();
+
+// Every timer gets its own thread, the callbacks run there like in the esp_timer task
+struct THostTimer {
+    esp_timer_create_args_t Args;
+    std::mutex Lock;
+    std::condition_variable Changed;
+    bool Armed = false;
+    bool Periodic = false;
+    uint64_t Generation = 0;
+    TClock::time_point Deadline;
+    TClock::duration Period{};
+
+    void Run() {
+        std::unique_lock lock(Lock);
+        while (true) {
+            Changed.wait(lock, [this] { return Armed; });
+            auto generation = Generation;
+            if (Changed.wait_until(lock, Deadline, [this, generation] { return Generation != generation; })) {
+                continue;
+            }
+            if (Periodic) {
+                Deadline += Period;
+            } else {
+                Armed = false;
+            }
+            lock.unlock();
+            Args.callback(Args.arg);
+            lock.lock();
+        }
+    }
+
+    void Start(uint64_t us, bool periodic) {
+        std::lock_guard lock(Lock);
+        Armed = true;
+        Periodic = periodic;
+        Period = std::chrono::microseconds(us);
+        Deadline = TClock::now() + Period;
+        ++Generation;
+        Changed.notify_one();
+    }
+
+    void Stop() {
+        std::lock_guard lock(Lock);
+        Armed = false;
+        ++Generation;
+        Changed.notify_one();
+    }
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+    auto timer = new THostTimer();
+    timer->Args = *create_args;
+    std::thread([timer] { timer->Run(); }).detach();
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    timer->Start(timeout_us, false);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    timer->Start(period, true);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    timer->Stop();
+    return ESP_OK;
+}
+
+// The thread of the timer is leaked together with it, timers live as long as the program
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    timer->Stop();
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(TClock::now() - Boot).count();
+}
@@ -0,0 +1,141 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using TClock = std::chrono::steady_clock;
+
+static const TClock::time_point Boot = TClock::now();
+
+static TClock::time_point TickToTime(TickType_t tick) {
+    return Boot + std::chrono::milliseconds(tick * portTICK_PERIOD_MS);
+}
+
+struct THostQueue {
+    size_t Length;
+    size_t ItemSize;
+    std::deque<std::vector<char>> Items;
+    std::mutex Lock;
+    std::condition_variable NotEmpty;
+    std::condition_variable NotFull;
+};
+
+template<typename TPredicate>
+static bool WaitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t wait, TPredicate predicate) {
+    if (wait == portMAX_DELAY) {
+        cv.wait(lock, predicate);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(wait * portTICK_PERIOD_MS), predicate);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    auto queue = new THostQueue();
+    queue->Length = length;
+    queue->ItemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait) {
+    std::unique_lock lock(queue->Lock);
+    if (!WaitFor(queue->NotFull, lock, wait, [queue] { return queue->Items.size() < queue->Length; })) {
+        return pdFALSE;
+    }
+    auto data = static_cast<const char*>(item);
+    queue->Items.emplace_back(data, data + queue->ItemSize);
+    queue->NotEmpty.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken) {
+    if (woken != nullptr) {
+        *woken = pdFALSE;
+    }
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait) {
+    std::unique_lock lock(queue->Lock);
+    if (!WaitFor(queue->NotEmpty, lock, wait, [queue] { return !queue->Items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->Items.front().data(), queue->ItemSize);
+    queue->Items.pop_front();
+    queue->NotFull.notify_one();
+    return pdTRUE;
+}
+
+struct THostTask {
+    uint32_t Notifications = 0;
+    std::mutex Lock;
+    std::condition_variable Notified;
+};
+
+static thread_local THostTask* CurrentTask = nullptr;
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char*, uint32_t, void* parameters, UBaseType_t, TaskHandle_t* created) {
+    auto task = new THostTask();
+    if (created != nullptr) {
+        *created = task;
+    }
+    std::thread([task, code, parameters] {
+        CurrentTask = task;
+        code(parameters);
+    }).detach();
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (CurrentTask == nullptr) {
+        CurrentTask = new THostTask();
+    }
+    return CurrentTask;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard lock(task->Lock);
+    ++task->Notifications;
+    task->Notified.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken) {
+    if (woken != nullptr) {
+        *woken = pdFALSE;
+    }
+    xTaskNotifyGive(task);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t wait) {
+    auto task = xTaskGetCurrentTaskHandle();
+    std::unique_lock lock(task->Lock);
+    WaitFor(task->Notified, lock, wait, [task] { return task->Notifications > 0; });
+    auto result = task->Notifications;
+    if (result > 0) {
+        task->Notifications = clearCountOnExit ? 0 : result - 1;
+    }
+    return result;
+}
+
+void vTaskDelete(TaskHandle_t) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t increment) {
+    *previousWakeTime += increment;
+    std::this_thread::sleep_until(TickToTime(*previousWakeTime));
+}
+
+TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(std::chrono::duration_cast<std::chrono::milliseconds>(TClock::now() - Boot).count() / portTICK_PERIOD_MS);
+}
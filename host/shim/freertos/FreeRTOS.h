@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+#include "sdkconfig.h"
+
+using TickType_t = uint32_t;
+using BaseType_t = int32_t;
+using UBaseType_t = uint32_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY static_cast<TickType_t>(0xffffffffUL)
+#define portTICK_PERIOD_MS (1000 / CONFIG_FREERTOS_HZ)
+#define pdMS_TO_TICKS(ms) static_cast<TickType_t>((ms) * CONFIG_FREERTOS_HZ / 1000)
@@ -0,0 +1,85 @@
+#include "nvs.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Every namespace is a map in memory, the handle is the index of the namespace
+static std::mutex Lock;
+static std::vector<std::string> Namespaces;
+static std::vector<std::map<std::string, std::string>> Values;
+
+esp_err_t nvs_open(const char* name, nvs_open_mode, nvs_handle* out_handle) {
+    std::lock_guard lock(Lock);
+    for (size_t i = 0; i < Namespaces.size(); ++i) {
+        if (Namespaces[i] == name) {
+            *out_handle = static_cast<nvs_handle>(i + 1);
+            return ESP_OK;
+        }
+    }
+    Namespaces.emplace_back(name);
+    Values.emplace_back();
+    *out_handle = static_cast<nvs_handle>(Namespaces.size());
+    return ESP_OK;
+}
+
+static std::map<std::string, std::string>* Find(nvs_handle handle) {
+    return handle == 0 || handle > Values.size() ? nullptr : &Values[handle - 1];
+}
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char* key, void* out_value, size_t* length) {
+    std::lock_guard lock(Lock);
+    auto values = Find(handle);
+    if (values == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto it = values->find(key);
+    if (it == values->end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out_value == nullptr) {
+        *length = it->second.size();
+        return ESP_OK;
+    }
+    if (*length < it->second.size()) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, it->second.data(), it->second.size());
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle handle, const char* key, const void* value, size_t length) {
+    std::lock_guard lock(Lock);
+    auto values = Find(handle);
+    if (values == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    (*values)[key].assign(static_cast<const char*>(value), length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle handle, const char* key, int32_t* out_value) {
+    size_t length = sizeof(*out_value);
+    return nvs_get_blob(handle, key, out_value, &length);
+}
+
+esp_err_t nvs_set_i32(nvs_handle handle, const char* key, int32_t value) {
+    return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_all(nvs_handle handle) {
+    std::lock_guard lock(Lock);
+    auto values = Find(handle);
+    if (values == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    values->clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle) {
+    return ESP_OK;
+}
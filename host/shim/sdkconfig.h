@@ -0,0 +1,4 @@
+#pragma once
+// Host replacement of the generated sdkconfig.h.
+// The options of the Christmas LED menu are passed by CMake as compile definitions.
+#define CONFIG_FREERTOS_HZ 1000
@@ -0,0 +1,38 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+#include "random.h"
+
+// Exponential backoff with jitter. The base delay doubles after every failed attempt up to the
+// cap and the delay is random in [base / 2, base], so the devices that lost the same access
+// point don't come back all at once.
+class TBackoff {
+public:
+    TBackoff(uint32_t minMs, uint32_t maxMs, uint32_t seed) : MinMs_(minMs), MaxMs_(maxMs), BaseMs_(minMs), Random_(seed) {
+    }
+
+    uint32_t NextMs() {
+        auto base = BaseMs_;
+        BaseMs_ = std::min(BaseMs_ * 2, MaxMs_);
+        ++Attempts_;
+        return base / 2 + Random_.Below(base / 2 + 1);
+    }
+
+    void Reset() {
+        BaseMs_ = MinMs_;
+        Attempts_ = 0;
+    }
+
+    // Since the last success
+    [[nodiscard]] uint32_t Attempts() const {
+        return Attempts_;
+    }
+
+private:
+    uint32_t MinMs_;
+    uint32_t MaxMs_;
+    uint32_t BaseMs_;
+    uint32_t Attempts_ = 0;
+    TRandom Random_;
+};
@@ -1,58 +1,85 @@
 #include "button.h"
+#include "gesture.h"
 #include "hardware.h"
+#include "wakeups.h"
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 #include <freertos/task.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 extern "C" {
 #include <esp_task_wdt.h>
 }
 
+// A raw edge as the interrupt has seen it
+struct TButtonEdge {
+    bool Pressed;
+    int64_t TimeUs;
+};
+
 static QueueHandle_t ButtonQueue;
 
-[[noreturn]] void ButtonTask(void* arg) {
+// A click toggles at the release, a double click selects the next mode and holding the button
+// ramps the brightness. A release between 9 and 12 s of holding erases the settings.
+static void OnGesture(void* arg, EGesture gesture, int64_t) {
     auto callback = static_cast<IButtonCallback*>(arg);
-    bool pressed = false;
-    size_t press_time = 0;
+    switch (gesture) {
+        case EGesture::Click:
+            callback->OnButtonToggle();
+            break;
+        case EGesture::DoubleClick:
+            callback->OnButtonNext();
+            break;
+        case EGesture::HoldBegin:
+            callback->OnButtonRampBegin();
+            break;
+        case EGesture::HoldStep:
+            callback->OnButtonRampStep();
+            break;
+        case EGesture::HoldEnd:
+            break;
+        case EGesture::ResetWindowBegin:
+            callback->OnButtonResetWindowBegin();
+            break;
+        case EGesture::ResetWindowEnd:
+            callback->OnButtonResetWindowEnd();
+            break;
+        case EGesture::Reset:
+            callback->OnButtonReset();
+            break;
+    }
+}
+
+[[noreturn]] void ButtonTask(void* arg) {
+    TGestureRecognizer recognizer(OnGesture, arg);
+    auto deadline = TGestureRecognizer::NoDeadline;
     while(true) {
         esp_task_wdt_reset();
-        bool value;
-        auto start = xTaskGetTickCount();
-        if (xQueueReceive(ButtonQueue, &value, 3000) == pdTRUE) {
-            if (press_time == 4) {
-                callback->OnButtonReset();
-            }
-            press_time = 0;
-            if (value) {
-                pressed = true;
-            } else {
-                if (pressed && xTaskGetTickCount() - start > 2) {
-                    callback->OnButtonNext();
-                }
-                pressed = false;
+        TickType_t wait = portMAX_DELAY;
+        if (deadline != TGestureRecognizer::NoDeadline) {
+            auto left = deadline - esp_timer_get_time();
+            wait = left > 0 ? static_cast<TickType_t>((left + 999) / 1000 / portTICK_PERIOD_MS) : 0;
+        }
+        TButtonEdge edge;
+        bool received = xQueueReceive(ButtonQueue, &edge, wait) == pdTRUE;
+        NWakeups::Count(EWakeSource::Button);
+        if (received) {
+            recognizer.Edge(edge.Pressed, edge.TimeUs);
+            while (xQueueReceive(ButtonQueue, &edge, 0) == pdTRUE) {
+                recognizer.Edge(edge.Pressed, edge.TimeUs);
             }
         } else {
-            if (press_time > 0) {
-                ++press_time;
-                if (press_time == 3) {
-                    callback->OnButtonResetWindowBegin();
-                } else if (press_time == 4) {
-                    callback->OnButtonResetWindowEnd();
-                }
-            }
-            if (pressed) {
-                callback->OnButtonToggle();
-                pressed = false;
-                press_time = 1;
-            }
+            // The edges of a burst of bounces can overflow the queue, the pin tells how it has settled
+            recognizer.Edge(!gpio_get_level(Button), esp_timer_get_time());
         }
+        deadline = recognizer.Advance(esp_timer_get_time());
     }
 }
 
 void ButtonIsrHandler(void *) {
-    bool value = !gpio_get_level(Button);
-    xQueueSendFromISR(ButtonQueue, &value, nullptr);
+    TButtonEdge edge{!gpio_get_level(Button), esp_timer_get_time()};
+    xQueueSendFromISR(ButtonQueue, &edge, nullptr);
 }
 
 void ButtonInit(IButtonCallback* callback) {
@@ -68,6 +95,7 @@ void ButtonInit(IButtonCallback* callback) {
     gpio_install_isr_service(0);
     gpio_isr_handler_add(Button, ButtonIsrHandler, nullptr);
 
-    ButtonQueue = xQueueCreate(6, sizeof(bool));
+    // Room for the bounces of a few presses
+    ButtonQueue = xQueueCreate(16, sizeof(TButtonEdge));
     xTaskCreate(ButtonTask, "ButtonTask", 2048, callback, 5, nullptr);
-}
\ No newline at end of file
+}
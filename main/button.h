@@ -5,9 +5,12 @@ public:
     virtual ~IButtonCallback() = default;
     virtual void OnButtonToggle() = 0;
     virtual void OnButtonNext() = 0;
+    // The button is held, the brightness ramps by steps until it is released
+    virtual void OnButtonRampBegin() = 0;
+    virtual void OnButtonRampStep() = 0;
     virtual void OnButtonResetWindowBegin() = 0;
     virtual void OnButtonResetWindowEnd() = 0;
     virtual void OnButtonReset() = 0;
 };
 
-void ButtonInit(IButtonCallback* callback);
\ No newline at end of file
+void ButtonInit(IButtonCallback* callback);
@@ -1,6 +1,7 @@
 #include <sys/param.h>
 
 #include "captive.h"
+#include "dns.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_netif.h"
@@ -10,144 +11,10 @@
 #include "lwip/sys.h"
 #include "lwip/netdb.h"
 
-#define DNS_PORT (53)
-#define DNS_MAX_LEN (256)
-
-#define OPCODE_MASK (0x7800)
-#define QR_FLAG (1 << 7)
-#define QD_TYPE_A (0x0001)
-#define ANS_TTL_SEC (300)
-
 static const char *TAG = "example_dns_redirect_server";
 
-// DNS Header Packet
-typedef struct __attribute__((__packed__)) {
-    uint16_t id;
-    uint16_t flags;
-    uint16_t qd_count;
-    uint16_t an_count;
-    uint16_t ns_count;
-    uint16_t ar_count;
-} dns_header_t;
-
-// DNS Question Packet
-typedef struct {
-    uint16_t type;
-    uint16_t class_;
-} dns_question_t;
-
-// DNS Answer Packet
-typedef struct __attribute__((__packed__))
-{
-    uint16_t ptr_offset;
-    uint16_t type;
-    uint16_t class_;
-    uint32_t ttl;
-    uint16_t addr_len;
-    uint32_t ip_addr;
-} dns_answer_t;
-
-/*
-    Parse the name from the packet from the DNS name format to a regular .-seperated name
-    returns the pointer to the next part of the packet
-*/
-static char *parse_dns_name(char *raw_name, char *parsed_name, size_t parsed_name_max_len)
-{
-
-    char *label = raw_name;
-    char *name_itr = parsed_name;
-    int name_len = 0;
-
-    do {
-        int sub_name_len = *label;
-        // (len + 1) since we are adding  a '.'
-        name_len += (sub_name_len + 1);
-        if (name_len > parsed_name_max_len) {
-            return NULL;
-        }
-
-        // Copy the sub name that follows the the label
-        memcpy(name_itr, label + 1, sub_name_len);
-        name_itr[sub_name_len] = '.';
-        name_itr += (sub_name_len + 1);
-        label += sub_name_len + 1;
-    } while (*label != 0);
-
-    // Terminate the final string, replacing the last '.'
-    parsed_name[name_len - 1] = '\0';
-    // Return pointer to first char after the name
-    return label + 1;
-}
-
-// Parses the DNS request and prepares a DNS response with the IP of the softAP
-static int parse_dns_request(char *req, size_t req_len, char *dns_reply, size_t dns_reply_max_len) {
-    if (req_len > dns_reply_max_len) {
-        return -1;
-    }
-
-    // Prepare the reply
-    memset(dns_reply, 0, dns_reply_max_len);
-    memcpy(dns_reply, req, req_len);
-
-    // Endianess of NW packet different from chip
-    auto header = reinterpret_cast<dns_header_t *>(dns_reply);
-    ESP_LOGI(TAG, "DNS query with header id: 0x%X, flags: 0x%X, qd_count: %d",
-             ntohs(header->id), ntohs(header->flags), ntohs(header->qd_count));
-
-    // Not a standard query
-    if ((header->flags & OPCODE_MASK) != 0) {
-        return 0;
-    }
-
-    // Set question response flag
-    header->flags |= QR_FLAG;
-
-    uint16_t qd_count = ntohs(header->qd_count);
-    header->an_count = htons(qd_count);
-
-    int reply_len = qd_count * sizeof(dns_answer_t) + req_len;
-    if (reply_len > dns_reply_max_len) {
-        return -1;
-    }
-
-    // Pointer to current answer and question
-    char *cur_ans_ptr = dns_reply + req_len;
-    char *cur_qd_ptr = dns_reply + sizeof(dns_header_t);
-    char name[128];
-
-    // Respond to all questions with the ESP32's IP address
-    for (int i = 0; i < qd_count; i++) {
-        const char *name_end_ptr = parse_dns_name(cur_qd_ptr, name, sizeof(name));
-        if (name_end_ptr == nullptr) {
-            ESP_LOGE(TAG, "Failed to parse DNS question: %s", cur_qd_ptr);
-            return -1;
-        }
-
-        dns_question_t question;
-        memcpy(&question, name_end_ptr, sizeof(question));
-        uint16_t qd_type = ntohs(question.type);
-        uint16_t qd_class = ntohs(question.class_);
-
-        ESP_LOGI(TAG, "Received type: %d | Class: %d | Question for: %s", qd_type, qd_class, name);
-
-        if (qd_type == QD_TYPE_A) {
-            auto *answer = reinterpret_cast<dns_answer_t *>(cur_ans_ptr);
-
-            answer->ptr_offset = htons(0xC000 | (cur_qd_ptr - dns_reply));
-            answer->type = htons(qd_type);
-            answer->class_ = htons(qd_class);
-            answer->ttl = htonl(ANS_TTL_SEC);
-
-            tcpip_adapter_ip_info_t  ip_info;
-            tcpip_adapter_get_ip_info(TCPIP_ADAPTER_IF_AP, &ip_info);
-            ESP_LOGI(TAG, "Answer with PTR offset: 0x%X and IP " IPSTR, ntohs(answer->ptr_offset), IP2STR(&ip_info.ip));
-
-            answer->addr_len = htons(sizeof(ip_info.ip.addr));
-            answer->ip_addr = ip_info.ip.addr;
-        }
-    }
-    return reply_len;
-}
+// A flood of probes is summarized in one line per period instead of a few lines per query
+static constexpr TickType_t LogPeriod = pdMS_TO_TICKS(10000);
 
 /*
     Sets up a socket and listen for DNS queries,
@@ -155,81 +22,63 @@ static int parse_dns_request(char *req, size_t req_len, char *dns_reply, size_t
 */
 void dns_server_task(void *pvParameters)
 {
-    char rx_buffer[128];
-    char addr_str[128];
-    int addr_family;
-    int ip_protocol;
+    // Static, the task stack is small. The reply is built in place over the query.
+    static uint8_t packet[NDns::MaxPacket];
+    uint32_t queries = 0;
+    uint32_t dropped = 0;
+    TickType_t loggedAt = xTaskGetTickCount();
 
     while (true) {
-
+        // The address of the AP does not change while it runs, it is read once per socket
         tcpip_adapter_ip_info_t  ip_info;
         tcpip_adapter_get_ip_info(TCPIP_ADAPTER_IF_AP, &ip_info);
         struct sockaddr_in dest_addr;
         dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
         dest_addr.sin_family = AF_INET;
-        dest_addr.sin_port = htons(DNS_PORT);
-        addr_family = AF_INET;
-        ip_protocol = IPPROTO_IP;
-        inet_ntoa_r(dest_addr.sin_addr, addr_str, sizeof(addr_str) - 1);
+        dest_addr.sin_port = htons(NDns::Port);
 
-        int sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
+        int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
         if (sock < 0) {
             ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
             break;
         }
-        ESP_LOGI(TAG, "Socket created");
 
         int err = bind(sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
         if (err < 0) {
             ESP_LOGE(TAG, "Socket unable to bind: errno %d", errno);
         }
-        ESP_LOGI(TAG, "Socket bound, port %d", DNS_PORT);
+        ESP_LOGI(TAG, "Socket bound, port %d, answering with " IPSTR, NDns::Port, IP2STR(&ip_info.ip));
 
         while (true) {
-            ESP_LOGI(TAG, "Waiting for data");
             struct sockaddr_in6 source_addr; // Large enough for both IPv4 or IPv6
             socklen_t socklen = sizeof(source_addr);
-            int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0, (struct sockaddr *)&source_addr, &socklen);
-
-            // Error occurred during receiving
+            int len = recvfrom(sock, packet, sizeof(packet), 0, (struct sockaddr *)&source_addr, &socklen);
             if (len < 0) {
                 ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
-                close(sock);
                 break;
             }
-                // Data received
-            else {
-                // Get the sender's ip address as string
-                if (source_addr.sin6_family == PF_INET) {
-                    inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr.s_addr, addr_str, sizeof(addr_str) - 1);
-                } else if (source_addr.sin6_family == PF_INET6) {
-                    inet6_ntoa_r(source_addr.sin6_addr, addr_str, sizeof(addr_str) - 1);
-                }
-
-                // Null-terminate whatever we received and treat like a string...
-                rx_buffer[len] = 0;
 
-                char reply[DNS_MAX_LEN];
-                int reply_len = parse_dns_request(rx_buffer, len, reply, DNS_MAX_LEN);
+            ++queries;
+            size_t reply_len = NDns::BuildReply(packet, len, sizeof(packet), ip_info.ip.addr);
+            if (reply_len == 0) {
+                ++dropped;
+            } else if (sendto(sock, packet, reply_len, 0, (struct sockaddr *)&source_addr, socklen) < 0) {
+                ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+                break;
+            }
 
-                ESP_LOGI(TAG, "Received %d bytes from %s | DNS reply with len: %d", len, addr_str, reply_len);
-                if (reply_len <= 0) {
-                    ESP_LOGE(TAG, "Failed to prepare a DNS reply");
-                } else {
-                    int err = sendto(sock, reply, reply_len, 0, (struct sockaddr *)&source_addr, sizeof(source_addr));
-                    if (err < 0) {
-                        ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
-                        break;
-                    }
-                }
+            auto now = xTaskGetTickCount();
+            if (now - loggedAt >= LogPeriod) {
+                ESP_LOGI(TAG, "%u queries, %u dropped", queries, dropped);
+                queries = 0;
+                dropped = 0;
+                loggedAt = now;
             }
         }
 
-        if (sock != -1) {
-            ESP_LOGE(TAG, "Shutting down socket");
-            shutdown(sock, 0);
-            close(sock);
-        }
+        ESP_LOGE(TAG, "Shutting down socket");
+        shutdown(sock, 0);
+        close(sock);
     }
     vTaskDelete(nullptr);
 }
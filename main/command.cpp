@@ -0,0 +1,184 @@
+#include "command.h"
+
+#include <array>
+
+namespace {
+    struct TStateName {
+        std::string_view Name;
+        EOutputState State;
+    };
+
+    constexpr std::array<TStateName, 6> PowerNames = {{
+        {"on", EOutputState::On},
+        {"true", EOutputState::On},
+        {"1", EOutputState::On},
+        {"off", EOutputState::Off},
+        {"false", EOutputState::Off},
+        {"0", EOutputState::Off},
+    }};
+
+    constexpr std::array<TStateName, 2> ActionNames = {{
+        {"toggle", EOutputState::Toggle},
+        {"next", EOutputState::Next},
+    }};
+
+    template<size_t Size>
+    bool FindState(const std::array<TStateName, Size>& names, std::string_view name, EOutputState& state) {
+        for (const auto& item : names) {
+            if (item.Name == name) {
+                state = item.State;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Digits only, the value must not be above max
+    bool ParseUnsigned(std::string_view value, uint32_t max, uint32_t& result) {
+        if (value.empty() || value.size() > 5) {
+            return false;
+        }
+        result = 0;
+        for (char ch : value) {
+            if (ch < '0' || ch > '9') {
+                return false;
+            }
+            result = result * 10 + (ch - '0');
+        }
+        return result <= max;
+    }
+
+    // Decimal number with up to two fraction digits, in hundredths
+    bool ParseHundredths(std::string_view value, uint32_t& result) {
+        auto point = value.find('.');
+        auto fraction = point == std::string_view::npos ? std::string_view{} : value.substr(point + 1);
+        uint32_t whole;
+        uint32_t hundredths = 0;
+        if (!ParseUnsigned(value.substr(0, point), 100, whole) || fraction.size() > 2) {
+            return false;
+        }
+        if (!fraction.empty() && !ParseUnsigned(fraction, 99, hundredths)) {
+            return false;
+        }
+        if (fraction.size() == 1) {
+            hundredths *= 10;
+        }
+        result = whole * 100 + hundredths;
+        return true;
+    }
+
+    // The names of the modes come from the registry
+    bool SetMode(std::string_view name, TCommand& command) {
+        auto mode = FindMode(name);
+        if (mode == ModeCount) {
+            return false;
+        }
+        command.State = EOutputState::Mode;
+        command.Mode = static_cast<uint8_t>(mode);
+        return true;
+    }
+
+    bool ParseMode(std::string_view value, TCommand& command) {
+        return FindState(ActionNames, value, command.State) || SetMode(value, command);
+    }
+
+    bool ParsePower(std::string_view value, TCommand& command) {
+        if (value == "toggle") {
+            command.State = EOutputState::Toggle;
+            return true;
+        }
+        return FindState(PowerNames, value, command.State);
+    }
+
+    bool ParseChannel(std::string_view value, TCommand& command) {
+        uint32_t channel;
+        if (!ParseUnsigned(value, OutputChannels - 1, channel)) {
+            return false;
+        }
+        command.Channel = static_cast<uint8_t>(channel);
+        return true;
+    }
+
+    bool ParseBrightness(std::string_view value, TCommand& command) {
+        uint32_t brightness;
+        if (!ParseUnsigned(value, 100, brightness)) {
+            return false;
+        }
+        command.Brightness = static_cast<uint8_t>(brightness);
+        return true;
+    }
+
+    bool ParseSpeed(std::string_view value, TCommand& command) {
+        uint32_t speed;
+        if (!ParseHundredths(value, speed) || speed < MinSpeed || speed > MaxSpeed) {
+            return false;
+        }
+        command.Speed = static_cast<uint16_t>(speed);
+        return true;
+    }
+
+    bool ParseIntensity(std::string_view value, TCommand& command) {
+        uint32_t intensity;
+        if (!ParseUnsigned(value, MaxIntensity, intensity)) {
+            return false;
+        }
+        command.Intensity = static_cast<uint8_t>(intensity);
+        return true;
+    }
+
+    bool ParseFade(std::string_view value, TCommand& command) {
+        uint32_t fade;
+        if (!ParseUnsigned(value, MaxFadeMs, fade)) {
+            return false;
+        }
+        command.Fade = static_cast<uint16_t>(fade);
+        return true;
+    }
+
+    struct TKey {
+        std::string_view Name;
+        bool (*Parse)(std::string_view value, TCommand& command);
+    };
+
+    constexpr std::array<TKey, 7> Keys = {{
+        {"mode", ParseMode},
+        {"power", ParsePower},
+        {"channel", ParseChannel},
+        {"brightness", ParseBrightness},
+        {"speed", ParseSpeed},
+        {"intensity", ParseIntensity},
+        {"fade", ParseFade},
+    }};
+
+    bool ParsePair(std::string_view pair, TCommand& command) {
+        auto equal = pair.find('=');
+        if (equal == std::string_view::npos) {
+            return false;
+        }
+        auto name = pair.substr(0, equal);
+        for (const auto& key : Keys) {
+            if (key.Name == name) {
+                return key.Parse(pair.substr(equal + 1), command);
+            }
+        }
+        return false;
+    }
+}
+
+bool ParseCommand(std::string_view payload, TCommand& command) {
+    // Longer payloads are not valid anyway, the limit bounds the parsing time
+    if (payload.empty() || payload.size() > 128) {
+        return false;
+    }
+    if (payload.find('=') == std::string_view::npos) {
+        return FindState(PowerNames, payload, command.State) || ParseMode(payload, command);
+    }
+    while (!payload.empty()) {
+        auto end = payload.find(';');
+        if (!ParsePair(payload.substr(0, end), command)) {
+            return false;
+        }
+        payload = end == std::string_view::npos ? std::string_view{} : payload.substr(end + 1);
+    }
+    return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <string_view>
+
+#include "output.h"
+
+// Parses the payload of a control message into the command. The payload is either a bare word
+// (on, off, toggle, next or the name of a mode) or a list of key=value pairs
+// separated by ';', for example mode=candle;brightness=40;speed=1.5;fade=800.
+// The keys are mode, power, channel, brightness (0-100), speed (0.1-10), intensity (0-100)
+// and fade (ms). Speed and intensity are set for the mode the channel is in after the command,
+// a mode with a narrower speed range, like candle (0.25-3), holds the speed to it.
+// The command is left in an unspecified state when false is returned.
+bool ParseCommand(std::string_view payload, TCommand& command);
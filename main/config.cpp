@@ -1,195 +1,63 @@
 #include "config.h"
+#include "config_internal.h"
+#include "form_parser.h"
 
 #include <esp_log.h>
+#include <cstdio>
+#include <cstdlib>
 #include <string_view>
 #include <string>
 #include <vector>
 #include <functional>
-#include <unordered_map>
 #include <array>
 #include <nvs.h>
 #include <esp_wifi.h>
 
 static const char *TAG="APP";
 extern const uint8_t LoginHtmlStart[] asm("_binary_login_html_start");
-extern const uint8_t SuccessHtmlStart[] asm("_binary_success_html_start");
+extern const uint8_t VerifyHtmlStart[] asm("_binary_verify_html_start");
 
-namespace NInternal {
-    template<typename TValuesHolder>
-    std::string ProcessTemplate(std::string_view source, TValuesHolder valuesHolder) {
-        std::string result;
-        result.reserve(source.size() + 100);
-        auto keyStart = source.end();
-        auto keyState = 0;
+// Enough for the driver to find the network, authenticate and get a lease, with a few retries
+static constexpr uint64_t VerifyTimeoutUs = 15000000;
+// The page gets the last status before the reboot
+static constexpr uint64_t RestartDelayUs = 3000000;
 
-        for (auto ch = source.begin(); ch != source.end(); ++ch) {
-            if (keyState == 0) {
-                if (*ch == '{') {
-                    keyStart = ch;
-                    keyState = 1;
-                } else {
-                    result += *ch;
-                }
-            } else if (keyState == 1) {
-                if (*ch != '{') {
-                    result += std::string_view(keyStart, ch - keyStart + 1);
-                    keyState = 0;
-                } else {
-                    keyState = 2;
-                }
-            } else if (keyState == 2) {
-                if (*ch == '}') {
-                    keyState = 3;
-                }
-            } else if (*ch != '}') {
-                result += std::string_view(keyStart, ch - keyStart + 1);
-                keyState = 0;
-            } else {
-                result += valuesHolder(std::string_view(keyStart + 2, ch - keyStart - 3));
-                keyStart = source.end();
-                keyState = 0;
-            }
-        }
-        if (keyState != 0) {
-            result += std::string_view(keyStart, source.end() - keyStart);
-        }
-        return result;
-    }
-
-    std::string EncodeHtml(std::string_view text) {
-        std::string result;
-        result.reserve(text.size() * 2);
-        for (char ch : text) {
-            switch (ch) {
-                case '&':
-                    result += "&amp;";
-                    break;
-                case '\'':
-                    result += "&apos;";
-                    break;
-                case '"':
-                    result += "&quot;";
-                    break;
-                case '<':
-                    result += "&lt;";
-                    break;
-                case '>':
-                    result += "&gt;";
-                    break;
-                default:
-                    result += ch;
-            }
-        }
-        return result;
-    }
-
-    class TRequestIterator {
-    public:
-        using iterator_category = std::forward_iterator_tag;
-        using difference_type   = std::ptrdiff_t;
-        using value_type        = char;
-        using pointer           = char*;  // or also value_type*
-        using reference         = char&;  // or also value_type&
-
-        explicit TRequestIterator(httpd_req_t *req)
-                : Request_(req)
-                , Remaining_(req->content_len)
-                , Portion_(0)
-                , Offset_(0) {
-            FetchNext();
-        }
-
-        TRequestIterator() : Request_(nullptr), Remaining_(0), Portion_(0), Offset_(0) {
-        }
-
-        char operator*() const {
-            return Buf_[Offset_];
-        }
-
-        TRequestIterator& operator++() {
-            if (!IsEmpty()) {
-                if (++Offset_ == Portion_) {
-                    FetchNext();
-                }
-            }
-            return *this;
-        }
-
-        bool operator != (const TRequestIterator& other) {
-            if (IsEmpty() && other.IsEmpty()) {
-                return false;
-            }
-            return Request_ != other.Request_ || Remaining_ != other.Remaining_ || Offset_ != other.Offset_;
-        }
-
-
-    private:
-
-        [[nodiscard]] bool IsEmpty() const {
-            return Remaining_ == 0 && Offset_ == Portion_;
-        }
+// Connectivity checks of the operating systems. Anything but the expected answer makes them
+// open the portal, so they are redirected to the config page straight from these constants.
+struct TProbe {
+    const char* Uri;
+    const char* Status;
+    // Null for the answers without a redirect
+    const char* Location;
+};
 
-        void FetchNext() {
-            if (Remaining_ == 0) {
-                return;
-            }
-            int ret;
-            do {
-                ret = httpd_req_recv(Request_, Buf_.data(), std::min(Remaining_, Buf_.size()));
-            } while (ret == HTTPD_SOCK_ERR_TIMEOUT);
-            if (ret < 0) {
-                Remaining_ = 0;
-            } else {
-                Remaining_ -= ret;
-            }
-            Offset_ = 0;
-            Portion_ = ret;
-        }
+static constexpr const char* PortalUrl = "http://192.168.4.1/";
 
-    private:
-        httpd_req_t *Request_;
-        size_t Remaining_;
-        std::array<char, 64> Buf_;
-        size_t Portion_;
-        size_t Offset_;
-    };
+static constexpr std::array<TProbe, 11> Probes = {{
+    {"/generate_204", "302 Found", PortalUrl},              // Android, ChromeOS
+    {"/gen_204", "302 Found", PortalUrl},                   // Android
+    {"/mobile/status.php", "302 Found", PortalUrl},         // Android
+    {"/connecttest.txt", "302 Found", PortalUrl},           // Windows 10 and newer
+    {"/ncsi.txt", "302 Found", PortalUrl},                  // Windows 7
+    {"/redirect", "302 Found", PortalUrl},                  // Windows
+    {"/success.txt", "302 Found", PortalUrl},               // Firefox
+    {"/canonical.html", "302 Found", PortalUrl},            // Firefox
+    {"/library/test/success.html", "302 Found", PortalUrl}, // Apple
+    {"/kindle-wifi/wifistub.html", "302 Found", PortalUrl}, // Kindle
+    {"/favicon.ico", "204 No Content", nullptr},
+}};
 
-    template<typename TIterator>
-    std::unordered_map<std::string, std::string> ReadUrlEncoded(TIterator begin, TIterator end) {
-        std::unordered_map<std::string, std::string> result;
-        bool percentMode = false;
-        std::string percentValue;
-        std::string key;
-        std::string value;
-        bool keyMode = true;
-        for (auto ch = begin; ch != end; ++ch) {
-            if (keyMode && *ch == '=') {
-                keyMode = false;
-            } else if (keyMode) {
-                key += *ch;
-            } else if (percentMode) {
-                percentValue += *ch;
-                if (percentValue.size() == 2) {
-                    value += static_cast<char>(std::stoul(percentValue, nullptr, 16));
-                    percentValue.clear();
-                    percentMode = false;
-                }
-            } else if (*ch == '%') {
-                percentMode = true;
-            } else if (*ch == '&') {
-                keyMode = true;
-                result.emplace(key, value);
-                key.clear();
-                value.clear();
-            } else {
-                value += *ch;
-            }
-        }
-        if (!key.empty()) {
-            result.emplace(key, value);
-        }
-        return result;
+// Closes the connection after the answer, a probe never comes back on it
+static esp_err_t ProbeHandler(httpd_req_t *req) {
+    auto probe = static_cast<const TProbe*>(req->user_ctx);
+    httpd_resp_set_status(req, probe->Status);
+    if (probe->Location != nullptr) {
+        httpd_resp_set_hdr(req, "Location", probe->Location);
     }
+    httpd_resp_set_hdr(req, "Connection", "close");
+    httpd_resp_send(req, nullptr, 0);
+    httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
+    return ESP_OK;
 }
 
 struct TConfigState {
@@ -205,6 +73,8 @@ esp_err_t ConfigGetHandler(httpd_req_t *req) {
     std::string result = NInternal::ProcessTemplate(response, [server](std::string_view key)-> std::string {
         if (key == "SSID") {
             return NInternal::EncodeHtml(server->GetSsid());
+        } else if (key == "MESSAGE" && !server->FailedSsid().empty()) {
+            return "<h3>Can't connect to Wi-Fi " + NInternal::EncodeHtml(server->FailedSsid()) + "</h3>";
         }
         return {};
     });
@@ -212,86 +82,240 @@ esp_err_t ConfigGetHandler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-void CheckGotIp(void* event_handler_arg,
-                esp_event_base_t event_base,
-                int32_t event_id,
-                void* event_data) {
-    auto server = static_cast<TConfigServer *>(event_handler_arg);
-    server->SendResult();
+static const char* VerifyStateName(EVerifyState state) {
+    switch (state) {
+        case EVerifyState::Idle:
+            return "idle";
+        case EVerifyState::Connecting:
+        case EVerifyState::Finishing:
+            return "connecting";
+        case EVerifyState::Connected:
+            return "connected";
+        case EVerifyState::Failed:
+            return "failed";
+        case EVerifyState::SaveFailed:
+            return "save_failed";
+    }
+    return "idle";
+}
+
+// Polled by the verify page, a few dozen bytes from the stack. A job that is not the last one is unknown.
+esp_err_t StatusHandler(httpd_req_t *req) {
+    auto server = static_cast<TConfigServer*>(req->user_ctx);
+    char query[32];
+    char value[12];
+    uint32_t job = 0;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+        && httpd_query_key_value(query, "job", value, sizeof(value)) == ESP_OK) {
+        job = strtoul(value, nullptr, 10);
+    }
+    auto state = job != 0 && job == server->VerifyJob() ? server->VerifyState() : EVerifyState::Idle;
+    char response[96];
+    int size = snprintf(response, sizeof(response), "{\"job\":%u,\"state\":\"%s\",\"elapsed\":%u,\"reason\":%u}",
+                        job, VerifyStateName(state), server->VerifyElapsedMs(), server->VerifyReason());
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_send(req, response, size);
+    return ESP_OK;
+}
+
+// A client that sends the form a byte at a time gets this long for all of it
+static constexpr int64_t FormTimeoutUs = 2000000;
+
+// Passes the body to the parser in the chunks it comes in. False when the client is gone, stalls
+// for the receive timeout of httpd or doesn't finish the form in time, the session is closed then.
+static bool ReceiveForm(httpd_req_t *req, TFormParser& parser) {
+    std::array<char, 128> buffer;
+    size_t remaining = req->content_len;
+    auto deadline = esp_timer_get_time() + FormTimeoutUs;
+    while (remaining > 0) {
+        if (esp_timer_get_time() > deadline) {
+            return false;
+        }
+        int received = httpd_req_recv(req, buffer.data(), std::min(remaining, buffer.size()));
+        if (received <= 0) {
+            return false;
+        }
+        parser.Feed({buffer.data(), static_cast<size_t>(received)});
+        remaining -= received;
+    }
+    parser.Finish();
+    return true;
 }
 
 esp_err_t ConfigSaveHandler(httpd_req_t *req) {
     ESP_LOGI(TAG, "Save Handler");
-    using namespace NInternal;
+    // The body is not read, whatever its size, the session is closed after the answer instead
     if (req->content_len > 512) {
-        for (auto ch = TRequestIterator{req}; ch != TRequestIterator{}; ++ch) {
-        }
         httpd_resp_set_status   (req, "413 Payload Too Large");
         httpd_resp_set_type     (req, HTTPD_TYPE_TEXT);
+        httpd_resp_set_hdr      (req, "Connection", "close");
         std::string_view response = "Payload too large";
         httpd_resp_send(req, response.data(), static_cast<ssize_t>(response.size()));
+        httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
         return ESP_OK;
     }
 
-    auto values = ReadUrlEncoded(NInternal::TRequestIterator{req}, NInternal::TRequestIterator{});
-    for (auto& kvp: values) {
-        ESP_LOGI(TAG, "Got '%s' = '%s'", kvp.first.data(), kvp.second.data());
+    // The sizes of wifi_sta_config_t
+    std::array<char, 32> ssidValue;
+    std::array<char, 64> passwordValue;
+    std::array<TFormField, 2> fields = {{
+        {"ssid", ssidValue.data(), ssidValue.size()},
+        {"password", passwordValue.data(), passwordValue.size()},
+    }};
+    TFormParser parser(fields.data(), fields.size());
+    if (!ReceiveForm(req, parser)) {
+        return ESP_FAIL;
     }
-    auto ssid = values.find("ssid");
-    auto password = values.find("password");
-    if (ssid == values.end() || password == values.end()) {
+    auto& ssid = fields[0];
+    auto& password = fields[1];
+    ESP_LOGI(TAG, "Got ssid '%.*s'", static_cast<int>(ssid.Size), ssid.Data);
+    if (!ssid.Found || !password.Found || ssid.Truncated || password.Truncated) {
         httpd_resp_set_status   (req, "400 Bad Request");
         httpd_resp_set_type     (req, HTTPD_TYPE_TEXT);
-        std::string_view response = "One of ssid or password is missing";
+        std::string_view response = "One of ssid or password is missing or too long";
         httpd_resp_send(req, response.data(), static_cast<ssize_t>(response.size()));
         return ESP_OK;
     }
 
     auto server = static_cast<TConfigServer*>(req->user_ctx);
+    auto job = server->StartVerify(ssid.Value(), password.Value());
+    if (job == 0) {
+        httpd_resp_set_status   (req, "409 Conflict");
+        httpd_resp_set_type     (req, HTTPD_TYPE_TEXT);
+        std::string_view response = "Another Wi-Fi is being checked";
+        httpd_resp_send(req, response.data(), static_cast<ssize_t>(response.size()));
+        return ESP_OK;
+    }
+    std::string_view response (reinterpret_cast<const char *>(VerifyHtmlStart));
+    std::string result = NInternal::ProcessTemplate(response, [job](std::string_view key)-> std::string {
+        if (key == "JOB") {
+            return std::to_string(job);
+        }
+        return {};
+    });
+    httpd_resp_set_status(req, "202 Accepted");
+    httpd_resp_send(req, result.data(), static_cast<ssize_t>(result.size()));
+    return ESP_OK;
+}
+
+uint32_t TConfigServer::StartVerify(std::string_view ssid, std::string_view password) {
+    auto state = State_.load();
+    if (state == EVerifyState::Connecting || state == EVerifyState::Finishing || state == EVerifyState::Connected) {
+        return 0;
+    }
+    auto job = ++Job_;
+    State_ = EVerifyState::Connecting;
+    std::copy(ssid.begin(), ssid.end(), Ssid_.begin());
+    std::copy(password.begin(), password.end(), Password_.begin());
+    SsidSize_ = static_cast<uint8_t>(ssid.size());
+    PasswordSize_ = static_cast<uint8_t>(password.size());
+    Reason_ = 0;
+    StartedAt_ = esp_timer_get_time();
+
     wifi_config_t config{};
+    std::copy(ssid.begin(), ssid.end(), config.sta.ssid);
+    std::copy(password.begin(), password.end(), config.sta.password);
+    ESP_LOGI(TAG, "Connecting to %.*s...", static_cast<int>(ssid.size()), ssid.data());
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA))
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &config))
+    ESP_ERROR_CHECK(esp_timer_start_once(Timeout_, VerifyTimeoutUs))
+    esp_wifi_connect();
+    return job;
+}
 
-    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &CheckGotIp, static_cast<void*>(req->user_ctx)));
-    std::copy(ssid->second.begin(), ssid->second.end(), config.ap.ssid);
-    std::copy(password->second.begin(), password->second.end(), config.ap.password);
-    ESP_LOGI(TAG, "Connecting to %s...", config.sta.ssid);
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &config));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_ERROR_CHECK(esp_wifi_connect());
-    auto result = server->WaitResult();
-    esp_wifi_disconnect();
-    esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, &CheckGotIp);
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
-    if (result) {
-        if (!server->Setup(ssid->second, password->second)) {
-            httpd_resp_set_status   (req, "500 Internal Server Error");
-            httpd_resp_set_type     (req, HTTPD_TYPE_TEXT);
-            std::string_view response = "Can't save data";
-            httpd_resp_send(req, response.data(), static_cast<ssize_t>(response.size()));
-            return ESP_OK;
+uint32_t TConfigServer::VerifyElapsedMs() const {
+    auto state = State_.load();
+    bool running = state == EVerifyState::Connecting || state == EVerifyState::Finishing;
+    auto end = running ? esp_timer_get_time() : FinishedAt_;
+    return static_cast<uint32_t>((end - StartedAt_) / 1000);
+}
+
+std::string_view TConfigServer::FailedSsid() const {
+    if (State_ != EVerifyState::Failed) {
+        return {};
+    }
+    return {Ssid_.data(), SsidSize_};
+}
+
+// Runs in the event loop task, the driver retries until it gets an address or the time is out
+void TConfigServer::OnWifiEvent(void* arg, esp_event_base_t base, int32_t id, void* data) {
+    auto server = static_cast<TConfigServer*>(arg);
+    if (server->State_ != EVerifyState::Connecting) {
+        return;
+    }
+    if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        if (server->Claim()) {
+            esp_timer_stop(server->Timeout_);
+            server->Finish(true);
         }
-        std::string_view response (reinterpret_cast<const char *>(SuccessHtmlStart));
-        httpd_resp_send(req, response.data(), static_cast<ssize_t>(response.size()));
-        vTaskDelay(3000);
-        esp_restart();
-        return ESP_OK;
-    } else {
-        std::string_view response (reinterpret_cast<const char *>(LoginHtmlStart));
-        std::string result = NInternal::ProcessTemplate(response, [server, ssid](std::string_view key)-> std::string {
-            if (key == "SSID") {
-                return NInternal::EncodeHtml(server->GetSsid());
-            } else if (key == "MESSAGE") {
-                return "<h3>Can't connect to Wi-Fi " + ssid->second + "</h3>";
-            }
-            return {};
-        });
-        httpd_resp_send(req, result.data(), static_cast<ssize_t>(response.size()));
-        return ESP_OK;
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        server->Reason_ = static_cast<wifi_event_sta_disconnected_t*>(data)->reason;
+        esp_wifi_connect();
+    }
+}
+
+void TConfigServer::OnTimeout(void* arg) {
+    auto server = static_cast<TConfigServer*>(arg);
+    if (server->Claim()) {
+        server->Finish(false);
+    }
+}
+
+void TConfigServer::OnRestart(void* arg) {
+    esp_restart();
+}
+
+// The address and the timeout can come at once from two tasks, only one of them finishes the job
+bool TConfigServer::Claim() {
+    auto expected = EVerifyState::Connecting;
+    return State_.compare_exchange_strong(expected, EVerifyState::Finishing);
+}
+
+void TConfigServer::Finish(bool connected) {
+    FinishedAt_ = esp_timer_get_time();
+    esp_wifi_disconnect();
+    esp_wifi_set_mode(WIFI_MODE_AP);
+    if (!connected) {
+        ESP_LOGI(TAG, "Can't connect, reason %d", Reason_.load());
+        State_ = EVerifyState::Failed;
+        return;
     }
+    if (!Setup({Ssid_.data(), SsidSize_}, {Password_.data(), PasswordSize_})) {
+        ESP_LOGE(TAG, "Can't save the config");
+        State_ = EVerifyState::SaveFailed;
+        return;
+    }
+    ESP_LOGI(TAG, "Connected, rebooting");
+    State_ = EVerifyState::Connected;
+    esp_timer_start_once(Restart_, RestartDelayUs);
 }
 
 void TConfigServer::Start() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    // The pages, the save and the probes
+    config.max_uri_handlers = 4 + Probes.size();
+    // Five of the ten LWIP sockets, the rest are for the listener, the control socket of httpd and
+    // the DNS server. When a burst of probes takes all of them, the least recently used one is
+    // closed for a new client. A client that stalls holds the only httpd task for 2 s, one that
+    // trickles the form for FormTimeoutUs and one more receive timeout at most.
+    config.max_open_sockets = 5;
+    config.lru_purge_enable = true;
+    config.recv_wait_timeout = 2;
+    config.send_wait_timeout = 2;
+
+    if (Timeout_ == nullptr) {
+        esp_timer_create_args_t timerArgs{};
+        timerArgs.callback = OnTimeout;
+        timerArgs.arg = this;
+        timerArgs.name = "verify";
+        ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &Timeout_))
+        timerArgs.callback = OnRestart;
+        timerArgs.name = "restart";
+        ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &Restart_))
+        ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &OnWifiEvent, this))
+        ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &OnWifiEvent, this))
+    }
 
     // Start the httpd server
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
@@ -319,6 +343,22 @@ void TConfigServer::Start() {
             .user_ctx  = this
         };
         httpd_register_uri_handler(Handle_, &save);
+        httpd_uri_t status = {
+            .uri       = "/status",
+            .method    = HTTP_GET,
+            .handler   = StatusHandler,
+            .user_ctx  = this
+        };
+        httpd_register_uri_handler(Handle_, &status);
+        for (const auto& probe : Probes) {
+            httpd_uri_t uri = {
+                .uri       = probe.Uri,
+                .method    = HTTP_GET,
+                .handler   = ProbeHandler,
+                .user_ctx  = const_cast<TProbe*>(&probe)
+            };
+            httpd_register_uri_handler(Handle_, &uri);
+        }
     } else {
         ESP_LOGI(TAG, "Error starting server!");
     }
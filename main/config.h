@@ -1,48 +1,90 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <esp_event.h>
 #include <esp_http_server.h>
-#include <semphr.h>
-#include "storage.h"
+#include <esp_timer.h>
+#include "config_store.h"
+
+enum class EVerifyState : uint8_t {
+    Idle,
+    Connecting,
+    // The address or the timeout came, Finish() is running
+    Finishing,
+    Connected,
+    Failed,
+    SaveFailed,
+};
 
 class TConfigServer {
 public:
-    TConfigServer(const TStorage* storage) : Storage_(storage), ConfigResult_(xSemaphoreCreateBinary()) {
+    TConfigServer(TConfigStore* config) : Config_(config) {
 
     }
     void Start();
     void Stop();
 
-    [[nodiscard]] std::string GetSsid() const {
-        return Storage_->Get("ssid");
+    [[nodiscard]] std::string_view GetSsid() const {
+        return Config_->GetString(EConfigKey::Ssid);
     }
 
-    [[nodiscard]] std::string GetPassword() const {
-        return Storage_->Get("password");
+    [[nodiscard]] std::string_view GetPassword() const {
+        return Config_->GetString(EConfigKey::Password);
     }
 
     [[nodiscard]] bool Setup(std::string_view ssid, std::string_view password) const {
-        if (!Storage_->Set("ssid", ssid)) {
-            return false;
-        }
-        if (!Storage_->Set("password", password)) {
-            return false;
-        }
-        if (!Storage_->Commit()) {
-            return false;
-        }
-        return true;
+        auto transaction = Config_->Begin();
+        // The access point of the old network is no use for the new one
+        transaction.SetString(EConfigKey::Bssid, {});
+        transaction.SetInt(EConfigKey::Channel, 0);
+        return transaction.SetString(EConfigKey::Ssid, ssid)
+            && transaction.SetString(EConfigKey::Password, password)
+            && transaction.Commit();
+    }
+
+    // Starts to connect with the credentials and returns at once. The result comes from the events
+    // of the Wi-Fi driver, the page polls it by the job number. Returns 0 while another job runs.
+    uint32_t StartVerify(std::string_view ssid, std::string_view password);
+
+    [[nodiscard]] uint32_t VerifyJob() const {
+        return Job_;
     }
 
-    [[nodiscard]] bool WaitResult() {
-        return xSemaphoreTake(ConfigResult_, 3000);
+    [[nodiscard]] EVerifyState VerifyState() const {
+        return State_;
     }
 
-    void SendResult() {
-        xSemaphoreGive(ConfigResult_);
+    [[nodiscard]] uint32_t VerifyElapsedMs() const;
+
+    [[nodiscard]] uint8_t VerifyReason() const {
+        return Reason_;
     }
 
+    // The SSID of the last job that could not connect, empty when there was none
+    [[nodiscard]] std::string_view FailedSsid() const;
+
+private:
+    static void OnWifiEvent(void* arg, esp_event_base_t base, int32_t id, void* data);
+    static void OnTimeout(void* arg);
+    static void OnRestart(void* arg);
+    bool Claim();
+    void Finish(bool connected);
+
 private:
     httpd_handle_t Handle_;
-    const TStorage* Storage_;
-    SemaphoreHandle_t ConfigResult_;
-};
\ No newline at end of file
+    TConfigStore* Config_;
+    esp_timer_handle_t Timeout_ = nullptr;
+    esp_timer_handle_t Restart_ = nullptr;
+    std::atomic<uint32_t> Job_{0};
+    std::atomic<EVerifyState> State_{EVerifyState::Idle};
+    int64_t StartedAt_ = 0;
+    int64_t FinishedAt_ = 0;
+    // The last disconnection reason of the driver, the page shows why it failed
+    std::atomic<uint8_t> Reason_{0};
+    // The sizes of wifi_sta_config_t
+    std::array<char, 32> Ssid_{};
+    std::array<char, 64> Password_{};
+    uint8_t SsidSize_ = 0;
+    uint8_t PasswordSize_ = 0;
+};
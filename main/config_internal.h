@@ -0,0 +1,73 @@
+#pragma once
+#include <string_view>
+#include <string>
+
+namespace NInternal {
+    template<typename TValuesHolder>
+    std::string ProcessTemplate(std::string_view source, TValuesHolder valuesHolder) {
+        std::string result;
+        result.reserve(source.size() + 100);
+        auto keyStart = source.end();
+        auto keyState = 0;
+
+        for (auto ch = source.begin(); ch != source.end(); ++ch) {
+            if (keyState == 0) {
+                if (*ch == '{') {
+                    keyStart = ch;
+                    keyState = 1;
+                } else {
+                    result += *ch;
+                }
+            } else if (keyState == 1) {
+                if (*ch != '{') {
+                    result += std::string_view(keyStart, ch - keyStart + 1);
+                    keyState = 0;
+                } else {
+                    keyState = 2;
+                }
+            } else if (keyState == 2) {
+                if (*ch == '}') {
+                    keyState = 3;
+                }
+            } else if (*ch != '}') {
+                result += std::string_view(keyStart, ch - keyStart + 1);
+                keyState = 0;
+            } else {
+                result += valuesHolder(std::string_view(keyStart + 2, ch - keyStart - 3));
+                keyStart = source.end();
+                keyState = 0;
+            }
+        }
+        if (keyState != 0) {
+            result += std::string_view(keyStart, source.end() - keyStart);
+        }
+        return result;
+    }
+
+    inline std::string EncodeHtml(std::string_view text) {
+        std::string result;
+        result.reserve(text.size() * 2);
+        for (char ch : text) {
+            switch (ch) {
+                case '&':
+                    result += "&amp;";
+                    break;
+                case '\'':
+                    result += "&apos;";
+                    break;
+                case '"':
+                    result += "&quot;";
+                    break;
+                case '<':
+                    result += "&lt;";
+                    break;
+                case '>':
+                    result += "&gt;";
+                    break;
+                default:
+                    result += ch;
+            }
+        }
+        return result;
+    }
+}
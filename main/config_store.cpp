@@ -0,0 +1,94 @@
+#include "config_store.h"
+
+#include <cstring>
+
+static_assert(ConfigFields.size() <= 32, "the transaction keeps the changed fields in a bit mask");
+
+void TConfigStore::Reset() {
+    Strings_ = {};
+    for (size_t i = 0; i < FieldCount; ++i) {
+        Numbers_[i] = ConfigFields[i].Type == EConfigType::String ? 0 : ConfigFields[i].Default;
+    }
+}
+
+void TConfigStore::Load() {
+    Reset();
+    for (size_t i = 0; i < FieldCount; ++i) {
+        const auto& field = ConfigFields[i];
+        if (field.Type == EConfigType::String) {
+            size_t size = field.MaxSize;
+            if (Storage_->Read(field.Name, Strings_.data() + Offsets[i], size)) {
+                Numbers_[i] = static_cast<int32_t>(size);
+            }
+        } else {
+            int32_t value;
+            if (Storage_->GetInt(field.Name, value)) {
+                Numbers_[i] = value;
+            }
+        }
+    }
+}
+
+void TConfigStore::Erase() {
+    Storage_->Erase();
+    Reset();
+}
+
+float TConfigStore::GetFloat(EConfigKey key) const {
+    float result;
+    memcpy(&result, &Numbers_[static_cast<size_t>(key)], sizeof(result));
+    return result;
+}
+
+TConfigStore::TTransaction TConfigStore::Begin() {
+    return TTransaction(this);
+}
+
+bool TConfigStore::TTransaction::SetString(EConfigKey key, std::string_view value) {
+    auto index = static_cast<size_t>(key);
+    if (value.size() > ConfigFields[index].MaxSize) {
+        return false;
+    }
+    memcpy(Strings_.data() + Offsets[index], value.data(), value.size());
+    Numbers_[index] = static_cast<int32_t>(value.size());
+    Changed_ |= 1u << index;
+    return true;
+}
+
+void TConfigStore::TTransaction::SetInt(EConfigKey key, int32_t value) {
+    auto index = static_cast<size_t>(key);
+    Numbers_[index] = value;
+    Changed_ |= 1u << index;
+}
+
+void TConfigStore::TTransaction::SetFloat(EConfigKey key, float value) {
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    SetInt(key, bits);
+}
+
+bool TConfigStore::TTransaction::Commit() {
+    const auto& storage = *Store_->Storage_;
+    for (size_t i = 0; i < FieldCount; ++i) {
+        if ((Changed_ & (1u << i)) == 0) {
+            continue;
+        }
+        const auto& field = ConfigFields[i];
+        bool written = field.Type == EConfigType::String
+            ? storage.Set(field.Name, {Strings_.data() + Offsets[i], static_cast<size_t>(Numbers_[i])})
+            : storage.SetInt(field.Name, Numbers_[i]);
+        if (!written) {
+            // Some fields may be in the flash already, the cache follows what is really there
+            Store_->Load();
+            return false;
+        }
+    }
+    if (Changed_ != 0 && !storage.Commit()) {
+        Store_->Load();
+        return false;
+    }
+    Store_->Strings_ = Strings_;
+    Store_->Numbers_ = Numbers_;
+    Changed_ = 0;
+    return true;
+}
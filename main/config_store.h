@@ -0,0 +1,122 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "storage.h"
+
+enum class EConfigType : uint8_t {
+    String,
+    Int,
+    Float,
+};
+
+enum class EConfigKey : uint8_t {
+    Ssid,
+    Password,
+    Bssid,
+    Channel,
+};
+
+struct TConfigField {
+    std::string_view Name;
+    EConfigType Type;
+    // Capacity of a string in the cache, the longer values are not stored
+    uint8_t MaxSize;
+    int32_t Default;
+};
+
+// The schema of the config namespace, in the order of EConfigKey
+inline constexpr std::array<TConfigField, 4> ConfigFields = {{
+    {"ssid", EConfigType::String, 32, 0},
+    {"password", EConfigType::String, 64, 0},
+    // The access point of the last connection, raw MAC bytes, and its channel, 0 is unknown
+    {"bssid", EConfigType::String, 6, 0},
+    {"channel", EConfigType::Int, 0, 0},
+}};
+
+namespace NConfig {
+    // Where the string of every field starts in the cache, the last entry is the total size
+    constexpr std::array<size_t, ConfigFields.size() + 1> Offsets() {
+        std::array<size_t, ConfigFields.size() + 1> offsets{};
+        for (size_t i = 0; i < ConfigFields.size(); ++i) {
+            offsets[i + 1] = offsets[i] + (ConfigFields[i].Type == EConfigType::String ? ConfigFields[i].MaxSize : 0);
+        }
+        return offsets;
+    }
+}
+
+// All fields of the namespace in RAM. Everything is read once by Load(), so the getters are
+// array lookups and return views into the cache. A view is valid until its field is committed
+// again. Enums are stored as integers, floats as their bits.
+class TConfigStore {
+public:
+    class TTransaction;
+
+    explicit TConfigStore(const TStorage* storage) : Storage_(storage) {
+    }
+
+    void Load();
+    // Erases the namespace and resets the cache to the defaults
+    void Erase();
+
+    [[nodiscard]] std::string_view GetString(EConfigKey key) const {
+        auto index = static_cast<size_t>(key);
+        return {Strings_.data() + Offsets[index], static_cast<size_t>(Numbers_[index])};
+    }
+
+    [[nodiscard]] int32_t GetInt(EConfigKey key) const {
+        return Numbers_[static_cast<size_t>(key)];
+    }
+
+    [[nodiscard]] float GetFloat(EConfigKey key) const;
+
+    template<typename TEnum>
+    [[nodiscard]] TEnum GetEnum(EConfigKey key) const {
+        return static_cast<TEnum>(GetInt(key));
+    }
+
+    // Changes are collected in the transaction and reach the flash and the cache only together
+    [[nodiscard]] TTransaction Begin();
+
+private:
+    static constexpr size_t FieldCount = ConfigFields.size();
+    static constexpr auto Offsets = NConfig::Offsets();
+
+    // The strings of all fields back to back. Numbers_ keeps the length of a string field.
+    using TStrings = std::array<char, Offsets[FieldCount]>;
+    using TNumbers = std::array<int32_t, FieldCount>;
+
+    void Reset();
+
+private:
+    const TStorage* Storage_;
+    TStrings Strings_{};
+    TNumbers Numbers_{};
+};
+
+class TConfigStore::TTransaction {
+public:
+    explicit TTransaction(TConfigStore* store) : Store_(store), Strings_(store->Strings_), Numbers_(store->Numbers_) {
+    }
+
+    // False when the value does not fit the field
+    bool SetString(EConfigKey key, std::string_view value);
+    void SetInt(EConfigKey key, int32_t value);
+    void SetFloat(EConfigKey key, float value);
+
+    template<typename TEnum>
+    void SetEnum(EConfigKey key, TEnum value) {
+        SetInt(key, static_cast<int32_t>(value));
+    }
+
+    // Writes the changed fields with one commit. The cache is updated only when all of them are written.
+    [[nodiscard]] bool Commit();
+
+private:
+    TConfigStore* Store_;
+    TStrings Strings_;
+    TNumbers Numbers_;
+    uint32_t Changed_ = 0;
+};
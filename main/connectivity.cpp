@@ -0,0 +1,149 @@
+#include "connectivity.h"
+
+#include <esp_log.h>
+#include <esp_system.h>
+
+static const char *TAG = "CONNECTIVITY";
+
+static constexpr uint32_t WifiMinBackoffMs = 500;
+static constexpr uint32_t WifiMaxBackoffMs = 60000;
+static constexpr uint32_t MqttMinBackoffMs = 1000;
+static constexpr uint32_t MqttMaxBackoffMs = 120000;
+
+TConnectivity::TConnectivity(std::string_view server, std::string_view username, std::string_view password, IMqttCallback* callback)
+    : Mqtt_(server, username, password, this)
+    , Callback_(callback)
+    , Lock_(xSemaphoreCreateMutex())
+    , WifiBackoff_(WifiMinBackoffMs, WifiMaxBackoffMs, esp_random())
+    , MqttBackoff_(MqttMinBackoffMs, MqttMaxBackoffMs, esp_random()) {
+}
+
+void TConnectivity::Start(TConfigStore* config) {
+    esp_timer_create_args_t timerArgs{};
+    timerArgs.callback = OnTimer;
+    timerArgs.arg = this;
+    timerArgs.name = "reconnect";
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &Timer_))
+    State_ = EConnectivityState::WifiConnecting;
+    ConnectWifi(config, this);
+}
+
+TConnectivityStats TConnectivity::Stats() const {
+    xSemaphoreTake(Lock_, portMAX_DELAY);
+    auto stats = Stats_;
+    xSemaphoreGive(Lock_);
+    return stats;
+}
+
+// Under the lock
+void TConnectivity::Retry(TBackoff& backoff, EConnectivityState state) {
+    State_ = state;
+    auto delayMs = backoff.NextMs();
+    ESP_LOGI(TAG, "Retry %u in %u ms", backoff.Attempts(), delayMs);
+    esp_timer_start_once(Timer_, static_cast<uint64_t>(delayMs) * 1000);
+}
+
+// Under the lock
+void TConnectivity::GoOffline() {
+    if (OfflineSinceUs_ == 0) {
+        OfflineSinceUs_ = esp_timer_get_time();
+    }
+}
+
+void TConnectivity::Run(EAction action) {
+    switch (action) {
+        case EAction::None:
+            break;
+        case EAction::ConnectWifi:
+            ReconnectWifi();
+            break;
+        case EAction::ConnectMqtt:
+            // Nothing would come back from the client, the attempt is made again later
+            if (!Mqtt_.Connect()) {
+                xSemaphoreTake(Lock_, portMAX_DELAY);
+                if (State_ == EConnectivityState::MqttConnecting) {
+                    Retry(MqttBackoff_, EConnectivityState::MqttBackoff);
+                }
+                xSemaphoreGive(Lock_);
+            }
+            break;
+    }
+}
+
+void TConnectivity::OnTimer(void* arg) {
+    auto self = static_cast<TConnectivity*>(arg);
+    auto action = EAction::None;
+    xSemaphoreTake(self->Lock_, portMAX_DELAY);
+    if (self->State_ == EConnectivityState::WifiBackoff) {
+        self->State_ = EConnectivityState::WifiConnecting;
+        ++self->Stats_.WifiReconnects;
+        action = EAction::ConnectWifi;
+    } else if (self->State_ == EConnectivityState::MqttBackoff) {
+        self->State_ = EConnectivityState::MqttConnecting;
+        ++self->Stats_.MqttReconnects;
+        action = EAction::ConnectMqtt;
+    }
+    xSemaphoreGive(self->Lock_);
+    self->Run(action);
+}
+
+void TConnectivity::OnWifiConnected(const tcpip_adapter_ip_info_t& info) {
+    xSemaphoreTake(Lock_, portMAX_DELAY);
+    WifiBackoff_.Reset();
+    State_ = EConnectivityState::MqttConnecting;
+    xSemaphoreGive(Lock_);
+    Run(EAction::ConnectMqtt);
+}
+
+void TConnectivity::OnWifiDisconnected() {
+    xSemaphoreTake(Lock_, portMAX_DELAY);
+    bool wasOnline = State_ == EConnectivityState::Online;
+    GoOffline();
+    esp_timer_stop(Timer_);
+    Retry(WifiBackoff_, EConnectivityState::WifiBackoff);
+    xSemaphoreGive(Lock_);
+    // The client itself would notice it only when its keepalive runs out
+    Mqtt_.Disconnect();
+    if (wasOnline) {
+        Callback_->OnMqttDisconnected(Mqtt_);
+    }
+}
+
+void TConnectivity::OnMqttConnected(const TMqttClient& client) {
+    xSemaphoreTake(Lock_, portMAX_DELAY);
+    MqttBackoff_.Reset();
+    State_ = EConnectivityState::Online;
+    if (OfflineSinceUs_ != 0) {
+        auto recoveryMs = static_cast<uint32_t>((esp_timer_get_time() - OfflineSinceUs_) / 1000);
+        Stats_.LastRecoveryMs = recoveryMs;
+        Stats_.MaxRecoveryMs = std::max(Stats_.MaxRecoveryMs, recoveryMs);
+        OfflineSinceUs_ = 0;
+        ESP_LOGI(TAG, "Recovered in %u ms", recoveryMs);
+    }
+    xSemaphoreGive(Lock_);
+    Callback_->OnMqttConnected(client);
+}
+
+void TConnectivity::OnMqttDisconnected(const TMqttClient& client) {
+    xSemaphoreTake(Lock_, portMAX_DELAY);
+    // Without Wi-Fi the broker is tried again after Wi-Fi comes back
+    bool retry = State_ == EConnectivityState::Online || State_ == EConnectivityState::MqttConnecting;
+    if (retry) {
+        GoOffline();
+        Retry(MqttBackoff_, EConnectivityState::MqttBackoff);
+    }
+    xSemaphoreGive(Lock_);
+    Callback_->OnMqttDisconnected(client);
+}
+
+void TConnectivity::OnMqttSubscribed(const TMqttClient& client, std::string_view topic) {
+    Callback_->OnMqttSubscribed(client, topic);
+}
+
+void TConnectivity::OnMqttUnsubscribed(std::string_view topic) {
+    Callback_->OnMqttUnsubscribed(topic);
+}
+
+void TConnectivity::OnMqttData(const TMqttClient& client, std::string_view topic, std::string_view data) {
+    Callback_->OnMqttData(client, topic, data);
+}
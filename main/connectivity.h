@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <string_view>
+
+#include "backoff.h"
+#include "config_store.h"
+#include "mqtt.h"
+#include "network.h"
+
+enum class EConnectivityState : uint8_t {
+    Idle,
+    WifiConnecting,
+    WifiBackoff,
+    MqttConnecting,
+    MqttBackoff,
+    Online,
+};
+
+struct TConnectivityStats {
+    uint32_t WifiReconnects;
+    uint32_t MqttReconnects;
+    // From the loss of the broker or of Wi-Fi to the broker again
+    uint32_t LastRecoveryMs;
+    uint32_t MaxRecoveryMs;
+};
+
+// Owns the Wi-Fi station and the only MQTT client. A lost link is retried after a backoff,
+// Wi-Fi first and then the broker, and the client is reconnected instead of being recreated.
+// The events of the MQTT client go on to the callback, a loss of Wi-Fi is a disconnection too.
+class TConnectivity : public INetworkCallback, public IMqttCallback {
+public:
+    TConnectivity(std::string_view server, std::string_view username, std::string_view password, IMqttCallback* callback);
+
+    void Start(TConfigStore* config);
+
+    [[nodiscard]] const TMqttClient& Mqtt() const {
+        return Mqtt_;
+    }
+
+    [[nodiscard]] EConnectivityState State() const {
+        return State_;
+    }
+
+    [[nodiscard]] TConnectivityStats Stats() const;
+
+    void OnWifiConnected(const tcpip_adapter_ip_info_t& info) override;
+    void OnWifiDisconnected() override;
+    void OnMqttConnected(const TMqttClient& client) override;
+    void OnMqttDisconnected(const TMqttClient& client) override;
+    void OnMqttSubscribed(const TMqttClient& client, std::string_view topic) override;
+    void OnMqttUnsubscribed(std::string_view topic) override;
+    void OnMqttData(const TMqttClient& client, std::string_view topic, std::string_view data) override;
+
+private:
+    // What to do with the drivers, it is done after the lock is released because their events
+    // come back to this class from their own tasks
+    enum class EAction : uint8_t {
+        None,
+        ConnectWifi,
+        ConnectMqtt,
+    };
+
+    static void OnTimer(void* arg);
+    void Retry(TBackoff& backoff, EConnectivityState state);
+    void GoOffline();
+    void Run(EAction action);
+
+private:
+    TMqttClient Mqtt_;
+    IMqttCallback* Callback_;
+    SemaphoreHandle_t Lock_;
+    esp_timer_handle_t Timer_ = nullptr;
+    EConnectivityState State_ = EConnectivityState::Idle;
+    TBackoff WifiBackoff_;
+    TBackoff MqttBackoff_;
+    int64_t OfflineSinceUs_ = 0;
+    TConnectivityStats Stats_{};
+};
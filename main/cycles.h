@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <sdkconfig.h>
+
+#ifndef __XTENSA__
+#include <chrono>
+#endif
+
+// Free running counter for the instrumentation. Differences stay correct over the wrap around,
+// which comes every 26 s at 160 MHz.
+namespace NCycles {
+#ifdef __XTENSA__
+    constexpr uint32_t PerUs = CONFIG_ESP8266_DEFAULT_CPU_FREQ_MHZ;
+
+    inline uint32_t Now() {
+        uint32_t ccount;
+        asm volatile("rsr %0, ccount" : "=a"(ccount));
+        return ccount;
+    }
+#else
+    // The host has no portable cycle counter, it counts nanoseconds instead
+    constexpr uint32_t PerUs = 1000;
+
+    inline uint32_t Now() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+    }
+#endif
+}
@@ -0,0 +1,105 @@
+#include "dns.h"
+
+#include <array>
+#include <cstring>
+
+namespace {
+    constexpr size_t HeaderSize = 12;
+    constexpr size_t AnswerSize = 16;
+    constexpr uint8_t MaxLabel = 63;
+    constexpr size_t MaxName = 255;
+    // A probe asks one question, more A answers than this are not given
+    constexpr size_t MaxAnswers = 8;
+
+    constexpr uint16_t QrFlag = 0x8000;
+    constexpr uint16_t OpcodeMask = 0x7800;
+    constexpr uint16_t TypeA = 1;
+
+    // Byte by byte, the fields are not aligned and the ESP8266 traps on unaligned loads
+    uint16_t Read16(const uint8_t* p) {
+        return static_cast<uint16_t>(p[0] << 8 | p[1]);
+    }
+
+    void Write16(uint8_t* p, uint16_t value) {
+        p[0] = static_cast<uint8_t>(value >> 8);
+        p[1] = static_cast<uint8_t>(value);
+    }
+
+    void Write32(uint8_t* p, uint32_t value) {
+        Write16(p, static_cast<uint16_t>(value >> 16));
+        Write16(p + 2, static_cast<uint16_t>(value));
+    }
+
+    // Returns the position after the name, or 0 when it is malformed. Queries don't use compression.
+    size_t SkipName(const uint8_t* packet, size_t pos, size_t length) {
+        size_t nameLength = 0;
+        while (pos < length) {
+            uint8_t label = packet[pos];
+            if (label == 0) {
+                return pos + 1;
+            }
+            if (label > MaxLabel) {
+                return 0;
+            }
+            nameLength += label + 1;
+            if (nameLength > MaxName) {
+                return 0;
+            }
+            pos += label + 1;
+        }
+        return 0;
+    }
+}
+
+size_t NDns::BuildReply(uint8_t* packet, size_t length, size_t capacity, uint32_t address) {
+    if (length < HeaderSize || length > capacity) {
+        return 0;
+    }
+    uint16_t flags = Read16(packet + 2);
+    uint16_t questions = Read16(packet + 4);
+    if ((flags & (QrFlag | OpcodeMask)) != 0 || questions == 0) {
+        return 0;
+    }
+
+    // Where the name and the class of every A question are
+    struct TQuestion {
+        uint16_t Name;
+        uint16_t Class;
+    };
+    std::array<TQuestion, MaxAnswers> found;
+    size_t answers = 0;
+    size_t pos = HeaderSize;
+    for (uint16_t i = 0; i < questions; ++i) {
+        size_t name = pos;
+        pos = SkipName(packet, pos, length);
+        if (pos == 0 || pos + 4 > length) {
+            return 0;
+        }
+        if (Read16(packet + pos) == TypeA && answers < found.size()) {
+            found[answers++] = {static_cast<uint16_t>(name), static_cast<uint16_t>(pos + 2)};
+        }
+        pos += 4;
+    }
+
+    // The authority and additional records of the query are dropped, the answers follow the questions
+    size_t fits = (capacity - pos) / AnswerSize;
+    if (answers > fits) {
+        answers = fits;
+    }
+    for (size_t i = 0; i < answers; ++i) {
+        uint8_t* answer = packet + pos;
+        Write16(answer, static_cast<uint16_t>(0xc000 | found[i].Name));
+        Write16(answer + 2, TypeA);
+        memcpy(answer + 4, packet + found[i].Class, 2);
+        Write32(answer + 6, AnswerTtl);
+        Write16(answer + 10, sizeof(address));
+        memcpy(answer + 12, &address, sizeof(address));
+        pos += AnswerSize;
+    }
+
+    Write16(packet + 2, flags | QrFlag);
+    Write16(packet + 6, static_cast<uint16_t>(answers));
+    Write16(packet + 8, 0);
+    Write16(packet + 10, 0);
+    return pos;
+}
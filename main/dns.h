@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace NDns {
+    constexpr uint16_t Port = 53;
+    // Largest DNS message over UDP without EDNS
+    constexpr size_t MaxPacket = 512;
+    constexpr uint32_t AnswerTtl = 300;
+
+    // Turns the query in the buffer into the reply in place: every A question is answered with
+    // the address, which is in network order like in tcpip_adapter_ip_info_t. Nothing is read
+    // past length and nothing is written past capacity. Returns the length of the reply, or 0
+    // when the packet is not a valid standard query and is dropped.
+    size_t BuildReply(uint8_t* packet, size_t length, size_t capacity, uint32_t address);
+}
@@ -0,0 +1,263 @@
+#pragma once
+#include "modes.h"
+#include "oscillator.h"
+
+#include "random.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// The generators behind the output modes. They are plain classes without virtual calls and
+// with as little state as possible, so the pixel effects can keep one instance per pixel.
+// The speed and the intensity live in the TParams of the effect, which configure() derives
+// from TModeParams. It is owned by the caller and shared by all instances of the effect.
+
+constexpr TLevel Ratio(uint32_t num, uint32_t den) {
+#ifdef CONFIG_MODES_FIXED_POINT
+    return TFixed::Ratio(num, den);
+#else
+    return static_cast<double>(num) / static_cast<double>(den);
+#endif
+}
+
+inline double ToDouble(TLevel value) {
+#ifdef CONFIG_MODES_FIXED_POINT
+    return value.ToDouble();
+#else
+    return value;
+#endif
+}
+
+inline TLevel Normal(TRandom& generator) {
+#ifdef CONFIG_MODES_FIXED_POINT
+    return TFixed::FromRaw(NRandom::NormalQ16(generator) << (TFixed::FractionBits - 16));
+#else
+    return NRandom::NormalQ16(generator) * (1.0 / 65536);
+#endif
+}
+
+class Static {
+public:
+    // The output has nothing to animate, it can sleep while the level is shown
+    static constexpr bool Constant = true;
+
+    struct TParams {
+    };
+
+    [[nodiscard]] TParams configure(const TModeParams&) const {
+        return {};
+    }
+
+    TLevel next(const TParams&, TRandom&) {
+        return TLevel(1.0);
+    }
+};
+
+// Intensity is the depth of the modulation, at 0 the level stays at the top
+class Dynamic {
+    TOscillator Oscillator;
+
+public:
+    struct TParams {
+        uint32_t Increment;
+        TLevel Depth;
+        TLevel Floor;
+    };
+
+    Dynamic(uint32_t period, EWaveform waveform) : Oscillator{waveform, period} {
+    }
+
+    [[nodiscard]] TParams configure(const TModeParams& params) const {
+        auto increment = static_cast<uint64_t>(Oscillator.GetIncrement()) * params.Speed / 100;
+        auto depth = Ratio(params.Intensity, 100);
+        return {static_cast<uint32_t>(std::min<uint64_t>(increment, UINT32_MAX)), depth, TLevel(1.0) - depth};
+    }
+
+    TLevel next(const TParams& params, TRandom&) {
+        return Oscillator.Next(params.Increment) * params.Depth + params.Floor;
+    }
+};
+
+// The time runs in a Q24 phase, so the speed is only the increment of it
+template<uint32_t Period>
+class Perlin {
+    static constexpr uint32_t One = 1u << 24;
+
+    TLevel Start{0};
+    TLevel Stop{0};
+    uint32_t Phase = 0;
+
+public:
+    // Rounded up, so at the normal speed a segment takes exactly Period frames
+    static constexpr uint32_t Increment(uint32_t speed) {
+        return static_cast<uint32_t>((static_cast<uint64_t>(One) * speed + 100 * Period - 1) / (100 * Period));
+    }
+
+    TLevel next(uint32_t increment, TRandom& generator) {
+        Phase += increment;
+        bool wrap = Phase >= One;
+#ifdef CONFIG_MODES_FIXED_POINT
+        TLevel x = TFixed::FromRaw(static_cast<int32_t>(wrap ? One : Phase) << (TFixed::FractionBits - 24));
+#else
+        TLevel x = (wrap ? One : Phase) * (1.0 / One);
+#endif
+        // 2 * (Start - Stop) * x^4 - (3 * Start - 5 * Stop) * x^3 - 3 * Stop * x^2 + Start * x
+        TLevel value = 2 * (Start - Stop);
+        value = x * value - (3 * Start - 5 * Stop);
+        value = x * value - 3 * Stop;
+        value = x * value + Start;
+        value = x * value;
+        if (wrap) {
+            Phase -= One;
+            Start = Stop;
+            Stop = Normal(generator);
+        }
+        return value;
+    }
+};
+
+// Intensity scales the flicker around the base level
+class Fireplace {
+    static constexpr TLevel Weight{.12};
+    static constexpr TLevel Base{.7};
+
+    Perlin<120> slow;
+    Perlin<60> middle;
+    Perlin<30> fast;
+
+public:
+    struct TParams {
+        uint32_t Slow;
+        uint32_t Middle;
+        uint32_t Fast;
+        TLevel Weight;
+    };
+
+    [[nodiscard]] TParams configure(const TModeParams& params) const {
+        return {
+            Perlin<120>::Increment(params.Speed),
+            Perlin<60>::Increment(params.Speed),
+            Perlin<30>::Increment(params.Speed),
+            Weight * Ratio(params.Intensity, 100),
+        };
+    }
+
+    TLevel next(const TParams& params, TRandom& generator) {
+        return (slow.next(params.Slow, generator) + middle.next(params.Middle, generator) + fast.next(params.Fast, generator)) * params.Weight + Base;
+    }
+};
+
+struct TPidCoefficients {
+    TLevel Proportional;
+    TLevel Differential;
+    TLevel Scale;
+};
+
+// The coefficients are passed by the owner, so every instance keeps only its own state
+class PidNoise {
+    TLevel Velocity{0};
+    TLevel Value{0};
+
+public:
+    TLevel next(const TPidCoefficients& coefficients, TRandom& generator) {
+        auto rnd = Normal(generator);
+        Velocity += rnd * coefficients.Scale - coefficients.Differential * Velocity - coefficients.Proportional * Value;
+        Value += Velocity;
+        return Value;
+    }
+};
+
+inline constexpr int Kernel[] = {
+    70, 17, 9, 3, 1,
+    30, 55, 10, 4, 1,
+    7, 15, 70, 6, 2,
+    7, 18, 20, 50, 5,
+    10, 30, 28, 20, 2
+};
+
+// The first row is used until the first mode search, so it starts from a steady flame
+inline constexpr std::array<TPidCoefficients, 6> FastCoefficients = {{
+    {TLevel(0), TLevel(0), TLevel(0)},
+    {TLevel(.001), TLevel(.08), TLevel(0)},
+    {TLevel(.008), TLevel(.06), TLevel(.0003)},
+    {TLevel(.02),  TLevel(.04), TLevel(.001)},
+    {TLevel(.05),  TLevel(.02), TLevel(.002)},
+    {TLevel(.2),   TLevel(.01), TLevel(.01)},
+}};
+
+inline constexpr std::array<TPidCoefficients, 6> SlowCoefficients = {{
+    {TLevel(0), TLevel(0), TLevel(0)},
+    {TLevel(.00001), TLevel(.01), TLevel(.000005)},
+    {TLevel(.0001),  TLevel(.01), TLevel(.00003)},
+    {TLevel(.0003),  TLevel(.01), TLevel(.00005)},
+    {TLevel(.0005),  TLevel(.01), TLevel(.00007)},
+    {TLevel(.001),   TLevel(.01), TLevel(.0001)},
+}};
+
+// The PID noise is a discrete oscillator with a step of one frame. A step of s frames is the
+// same system with Differential * s, Proportional * s^2 and Scale * s^1.5, where s is the speed.
+// Above 3 the fast coefficients stop being stable, below 0.25 the slow ones get lost in Q8.24.
+class Candle {
+    static constexpr TLevel Base{.6};
+
+    uint8_t Mode = 0;
+    uint8_t Coefficients = 0;
+    uint16_t Latency = 0;
+
+    PidNoise fast{};
+    PidNoise slow{};
+
+public:
+    // The output holds the speed of the commands to these
+    static constexpr uint16_t MinSpeed = 25;
+    static constexpr uint16_t MaxSpeed = 300;
+
+    struct TParams {
+        std::array<TPidCoefficients, 6> Fast;
+        std::array<TPidCoefficients, 6> Slow;
+        // Frames between the mode searches
+        uint16_t Latency;
+    };
+
+    [[nodiscard]] TParams configure(const TModeParams& params) const {
+        uint32_t speed = std::clamp(params.Speed, MinSpeed, MaxSpeed);
+        double s = speed / 100.0;
+        double noise = s * std::sqrt(s) * params.Intensity / 100.0;
+        auto scale = [&](const TPidCoefficients& coefficients) {
+            return TPidCoefficients{
+                TLevel(ToDouble(coefficients.Proportional) * s * s),
+                TLevel(ToDouble(coefficients.Differential) * s),
+                TLevel(ToDouble(coefficients.Scale) * noise),
+            };
+        };
+        TParams result{};
+        for (size_t i = 0; i < result.Fast.size(); ++i) {
+            result.Fast[i] = scale(FastCoefficients[i]);
+            result.Slow[i] = scale(SlowCoefficients[i]);
+        }
+        result.Latency = static_cast<uint16_t>(100 * 100 / speed);
+        return result;
+    }
+
+    TLevel next(const TParams& params, TRandom& generator) {
+        if (Latency++ >= params.Latency) {
+            Latency = 0;
+            Mode = searchMode(generator);
+            Coefficients = Mode + 1;
+        }
+        return fast.next(params.Fast[Coefficients], generator) + slow.next(params.Slow[Coefficients], generator) + Base;
+    }
+
+private:
+    [[nodiscard]] uint8_t searchMode(TRandom& generator) const {
+        auto r = generator.Below(100);
+        for (uint8_t i = 0; i < 5; ++i) {
+            uint32_t k = Kernel[i + Mode * 5];
+            if (r < k)
+                return i;
+            r -= k;
+        }
+        return 0;
+    }
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+
+// Signed Q8.24 number. Range is about +-128 with 6e-8 resolution, which is enough for
+// the slow PID coefficients of the candle (1e-5) and the polynomial of the perlin noise.
+class TFixed {
+public:
+    static constexpr int FractionBits = 24;
+    static constexpr int32_t One = 1 << FractionBits;
+
+    constexpr TFixed() = default;
+
+    explicit constexpr TFixed(double value)
+        : Raw_(static_cast<int32_t>(value * One + (value < 0 ? -0.5 : 0.5))) {
+    }
+
+    static constexpr TFixed FromRaw(int32_t raw) {
+        TFixed result;
+        result.Raw_ = raw;
+        return result;
+    }
+
+    // num / den, computed with an integer division
+    static constexpr TFixed Ratio(uint32_t num, uint32_t den) {
+        return FromRaw(static_cast<int32_t>((static_cast<int64_t>(num) << FractionBits) / den));
+    }
+
+    [[nodiscard]] constexpr int32_t Raw() const {
+        return Raw_;
+    }
+
+    [[nodiscard]] constexpr double ToDouble() const {
+        return static_cast<double>(Raw_) / One;
+    }
+
+    // Converts [0, 1] to [0, scale] without going through the floating point
+    [[nodiscard]] constexpr uint32_t Scale(uint32_t scale) const {
+        return static_cast<uint32_t>((static_cast<int64_t>(Raw_) * scale) >> FractionBits);
+    }
+
+    constexpr TFixed operator-() const {
+        return FromRaw(-Raw_);
+    }
+
+    constexpr TFixed& operator+=(TFixed other) {
+        Raw_ += other.Raw_;
+        return *this;
+    }
+
+    constexpr TFixed& operator-=(TFixed other) {
+        Raw_ -= other.Raw_;
+        return *this;
+    }
+
+    friend constexpr TFixed operator+(TFixed a, TFixed b) {
+        return FromRaw(a.Raw_ + b.Raw_);
+    }
+
+    friend constexpr TFixed operator-(TFixed a, TFixed b) {
+        return FromRaw(a.Raw_ - b.Raw_);
+    }
+
+    // Rounds to nearest, plain truncation biases the slow feedback loops of the candle
+    friend constexpr TFixed operator*(TFixed a, TFixed b) {
+        return FromRaw(static_cast<int32_t>((static_cast<int64_t>(a.Raw_) * b.Raw_ + (One >> 1)) >> FractionBits));
+    }
+
+    friend constexpr TFixed operator*(TFixed a, int32_t b) {
+        return FromRaw(a.Raw_ * b);
+    }
+
+    friend constexpr TFixed operator*(int32_t a, TFixed b) {
+        return FromRaw(a * b.Raw_);
+    }
+
+    friend constexpr bool operator<(TFixed a, TFixed b) {
+        return a.Raw_ < b.Raw_;
+    }
+
+    friend constexpr bool operator>(TFixed a, TFixed b) {
+        return a.Raw_ > b.Raw_;
+    }
+
+private:
+    int32_t Raw_ = 0;
+};
+
+namespace NFixed {
+    constexpr double Pi = 3.14159265358979323846;
+
+    // The math of <cmath> is not constexpr, so the tables are filled with series at compile time
+    constexpr double ConstSin(double x) {
+        while (x > Pi) {
+            x -= 2 * Pi;
+        }
+        while (x < -Pi) {
+            x += 2 * Pi;
+        }
+        double term = x;
+        double result = x;
+        for (int i = 1; i < 12; ++i) {
+            term *= -x * x / ((2 * i) * (2 * i + 1));
+            result += term;
+        }
+        return result;
+    }
+
+    constexpr double ConstSqrt(double x) {
+        if (x <= 0) {
+            return 0;
+        }
+        double result = x < 1 ? 1 : x;
+        for (int i = 0; i < 64; ++i) {
+            result = (result + x / result) / 2;
+        }
+        return result;
+    }
+
+    // ln(x) = k * ln(2) + 2 * atanh((m - 1) / (m + 1)), where x = m * 2^k and m is in [1, 2)
+    constexpr double ConstLog(double x) {
+        constexpr double Ln2 = 0.69314718055994530942;
+        int k = 0;
+        while (x >= 2) {
+            x /= 2;
+            ++k;
+        }
+        while (x < 1) {
+            x *= 2;
+            --k;
+        }
+        double y = (x - 1) / (x + 1);
+        double term = y;
+        double result = 0;
+        for (int i = 1; i < 60; i += 2) {
+            result += term / i;
+            term *= y * y;
+        }
+        return k * Ln2 + 2 * result;
+    }
+}
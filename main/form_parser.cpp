@@ -0,0 +1,125 @@
+#include "form_parser.h"
+
+// -1 for a character that is not a hex digit
+static int HexValue(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+void TFormParser::Feed(std::string_view chunk) {
+    for (char ch : chunk) {
+        Consume(ch);
+    }
+}
+
+void TFormParser::Finish() {
+    // A broken escape at the very end is kept as it is
+    if (Escape_ > 0) {
+        Put('%');
+        if (Escape_ == 2) {
+            Put(EscapeHigh_);
+        }
+        Escape_ = 0;
+    }
+    EndPair();
+}
+
+void TFormParser::Consume(char ch) {
+    if (Escape_ == 1) {
+        if (HexValue(ch) >= 0) {
+            EscapeHigh_ = ch;
+            Escape_ = 2;
+            return;
+        }
+        Escape_ = 0;
+        Put('%');
+    } else if (Escape_ == 2) {
+        Escape_ = 0;
+        int low = HexValue(ch);
+        if (low >= 0) {
+            Put(static_cast<char>(HexValue(EscapeHigh_) << 4 | low));
+            return;
+        }
+        Put('%');
+        Put(EscapeHigh_);
+    }
+
+    switch (ch) {
+        case '%':
+            Escape_ = 1;
+            break;
+        case '+':
+            Put(' ');
+            break;
+        case '&':
+            EndPair();
+            break;
+        case '=':
+            if (!InValue_) {
+                EndKey();
+            } else {
+                Put(ch);
+            }
+            break;
+        default:
+            Put(ch);
+    }
+}
+
+void TFormParser::Put(char ch) {
+    if (!InValue_) {
+        if (KeySize_ < MaxKey) {
+            Key_[KeySize_++] = ch;
+        } else {
+            KeyTooLong_ = true;
+        }
+        return;
+    }
+    if (Field_ == nullptr) {
+        return;
+    }
+    if (Field_->Size < Field_->Capacity) {
+        Field_->Data[Field_->Size++] = ch;
+    } else {
+        Field_->Truncated = true;
+    }
+}
+
+void TFormParser::EndKey() {
+    InValue_ = true;
+    Field_ = nullptr;
+    if (KeyTooLong_) {
+        return;
+    }
+    std::string_view key(Key_, KeySize_);
+    for (size_t i = 0; i < Count_; ++i) {
+        if (Fields_[i].Name == key) {
+            if (!Fields_[i].Found) {
+                Field_ = &Fields_[i];
+                Field_->Found = true;
+                Field_->Size = 0;
+                Field_->Truncated = false;
+            }
+            return;
+        }
+    }
+}
+
+void TFormParser::EndPair() {
+    // A key without '=' has an empty value, an empty pair is nothing
+    if (!InValue_ && (KeySize_ > 0 || KeyTooLong_)) {
+        EndKey();
+    }
+    InValue_ = false;
+    Field_ = nullptr;
+    KeySize_ = 0;
+    KeyTooLong_ = false;
+}
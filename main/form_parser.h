@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// A key the form parser looks for and the buffer its value is decoded into
+struct TFormField {
+    std::string_view Name;
+    char* Data;
+    size_t Capacity;
+    size_t Size = 0;
+    bool Found = false;
+    // The value was longer than the capacity, the rest of it is dropped
+    bool Truncated = false;
+
+    [[nodiscard]] std::string_view Value() const {
+        return {Data, Size};
+    }
+};
+
+// Decodes an application/x-www-form-urlencoded body as it arrives, in chunks of any size. Only the
+// declared keys are kept, straight in their buffers, so nothing is allocated. The rules are the
+// ones of the browsers: '+' is a space, %XX is a byte and a '%' that is not followed by two hex
+// digits stays as it is. The first occurrence of a key wins, like in the old parser.
+class TFormParser {
+public:
+    TFormParser(TFormField* fields, size_t count) : Fields_(fields), Count_(count) {
+    }
+
+    void Feed(std::string_view chunk);
+    // Ends the last pair, must be called after the last chunk
+    void Finish();
+
+private:
+    void Consume(char ch);
+    void Put(char ch);
+    void EndKey();
+    void EndPair();
+
+    // Longer keys are not among the declared ones
+    static constexpr size_t MaxKey = 16;
+
+private:
+    TFormField* Fields_;
+    size_t Count_;
+    bool InValue_ = false;
+    char Key_[MaxKey];
+    size_t KeySize_ = 0;
+    bool KeyTooLong_ = false;
+    // Where the value goes, null when it is skipped
+    TFormField* Field_ = nullptr;
+    // Number of the characters of an escape seen so far, the '%' and maybe the first digit
+    uint8_t Escape_ = 0;
+    char EscapeHigh_ = 0;
+};
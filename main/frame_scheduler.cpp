@@ -0,0 +1,80 @@
+#include "frame_scheduler.h"
+
+#include <esp_err.h>
+
+TFrameScheduler::TFrameScheduler(uint32_t frameRate, TCallback callback, void* arg)
+    : FrameRate_(frameRate)
+    , PeriodUs_(1000000 / frameRate)
+    , PeriodRemainder_(1000000 % frameRate)
+    , Callback_(callback)
+    , Arg_(arg) {
+}
+
+void TFrameScheduler::Start() {
+    if (Timer_ == nullptr) {
+        esp_timer_create_args_t timerArgs{};
+        timerArgs.callback = OnTimer;
+        timerArgs.arg = this;
+        timerArgs.name = "frame";
+        ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &Timer_))
+    }
+    // The deadline is only touched in the esp_timer task, the first callback sets it from its now.
+    // A callback in flight when it was stopped may have armed it again, then that one restarts.
+    esp_timer_stop(Timer_);
+    Restart_ = true;
+    Running_ = true;
+    esp_timer_start_once(Timer_, 0);
+}
+
+void TFrameScheduler::Stop() {
+    Running_ = false;
+    if (Timer_ != nullptr) {
+        esp_timer_stop(Timer_);
+    }
+}
+
+void TFrameScheduler::Advance() {
+    Deadline_ += PeriodUs_;
+    Remainder_ += PeriodRemainder_;
+    if (Remainder_ >= FrameRate_) {
+        Remainder_ -= FrameRate_;
+        ++Deadline_;
+    }
+}
+
+void TFrameScheduler::OnTimer(void* arg) {
+    auto self = static_cast<TFrameScheduler*>(arg);
+    auto now = esp_timer_get_time();
+    if (self->Restart_.exchange(false)) {
+        self->Deadline_ = now;
+        self->Remainder_ = 0;
+        self->Advance();
+        esp_timer_start_once(self->Timer_, self->PeriodUs_);
+        return;
+    }
+    auto late = now - self->Deadline_;
+    self->Jitter_.Add(static_cast<uint32_t>(late < 0 ? -late : late));
+    uint32_t skipped = 0;
+    while (now - self->Deadline_ >= self->PeriodUs_) {
+        self->Advance();
+        ++skipped;
+    }
+    if (skipped > 0) {
+        self->MissedDeadlines_ += skipped;
+    }
+    self->Frames_ += 1 + skipped;
+    self->Callback_(self->Arg_, skipped);
+
+    self->Advance();
+    if (!self->Running_) {
+        return;
+    }
+    now = esp_timer_get_time();
+    esp_timer_start_once(self->Timer_, self->Deadline_ > now ? self->Deadline_ - now : 0);
+}
+
+TJitterHistogram TFrameScheduler::TakeJitter() {
+    auto result = Jitter_;
+    Jitter_ = {};
+    return result;
+}
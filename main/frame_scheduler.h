@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <esp_timer.h>
+
+#include "histogram.h"
+
+// Distance of the frame starts from their deadlines in microseconds, buckets from 32 us to 2 ms
+using TJitterHistogram = THistogram<5>;
+
+// Calls the frame callback at a fixed rate. Every frame is armed against its absolute deadline,
+// so late callbacks do not shift the following ones. When the callback comes later than a whole
+// frame, the missed frames are counted and passed to the callback, which skips them to keep the
+// animation in time with the wall clock.
+class TFrameScheduler {
+public:
+    using TCallback = void (*)(void* arg, uint32_t skipped);
+
+    TFrameScheduler(uint32_t frameRate, TCallback callback, void* arg);
+
+    // Starts the frames from now, also after a stop. A stop ends them until the next start.
+    void Start();
+    void Stop();
+
+    [[nodiscard]] uint32_t FrameRate() const {
+        return FrameRate_;
+    }
+
+    [[nodiscard]] uint32_t PeriodUs() const {
+        return PeriodUs_;
+    }
+
+    [[nodiscard]] uint32_t Frames() const {
+        return Frames_;
+    }
+
+    [[nodiscard]] uint32_t MissedDeadlines() const {
+        return MissedDeadlines_;
+    }
+
+    // Returns the jitter since the previous call. It is not locked against the timer,
+    // a frame that comes in the middle of the copy can be lost from the statistics.
+    TJitterHistogram TakeJitter();
+
+private:
+    static void OnTimer(void* arg);
+    void Advance();
+
+private:
+    uint32_t FrameRate_;
+    uint32_t PeriodUs_;
+    // 1000000 / FrameRate_ is not always whole, the remainder is spread like in Bresenham's line
+    uint32_t PeriodRemainder_;
+    // Touched only in the esp_timer task
+    uint32_t Remainder_ = 0;
+    int64_t Deadline_ = 0;
+    TCallback Callback_;
+    void* Arg_;
+    esp_timer_handle_t Timer_ = nullptr;
+    std::atomic<bool> Running_{false};
+    // Set by Start(), the next callback begins the frames from its time
+    std::atomic<bool> Restart_{false};
+    std::atomic<uint32_t> Frames_{0};
+    std::atomic<uint32_t> MissedDeadlines_{0};
+    TJitterHistogram Jitter_;
+};
@@ -0,0 +1,88 @@
+#include "gesture.h"
+
+#include <algorithm>
+
+void TGestureRecognizer::Edge(bool pressed, int64_t timeUs) {
+    Advance(timeUs);
+    if (pressed == RawLevel_) {
+        return;
+    }
+    RawLevel_ = pressed;
+    RawTimeUs_ = timeUs;
+    if (LockedUntilUs_ == 0 && pressed != Level_) {
+        Accept(pressed, timeUs);
+    }
+}
+
+int64_t TGestureRecognizer::Advance(int64_t nowUs) {
+    // The contact may have settled at the other level inside the debounce
+    while (LockedUntilUs_ != 0 && nowUs >= LockedUntilUs_) {
+        auto lockEnd = LockedUntilUs_;
+        LockedUntilUs_ = 0;
+        if (RawLevel_ != Level_) {
+            Accept(RawLevel_, std::max(RawTimeUs_, lockEnd));
+        }
+    }
+
+    if (Level_) {
+        auto held = nowUs - PressedAtUs_;
+        if (!Holding_ && held >= HoldUs) {
+            Holding_ = true;
+            NextStepUs_ = PressedAtUs_ + HoldUs;
+            Emit(EGesture::HoldBegin, nowUs);
+        }
+        // One step per call, a late call doesn't make a jump
+        if (Holding_ && nowUs >= NextStepUs_) {
+            NextStepUs_ = std::max(NextStepUs_ + RampStepUs, nowUs);
+            Emit(EGesture::HoldStep, nowUs);
+        }
+        if (ResetWindow_ == 0 && held >= ResetWindowBeginUs) {
+            ResetWindow_ = 1;
+            Emit(EGesture::ResetWindowBegin, nowUs);
+        }
+        if (ResetWindow_ == 1 && held >= ResetWindowEndUs) {
+            ResetWindow_ = 2;
+            Emit(EGesture::ResetWindowEnd, nowUs);
+        }
+    }
+
+    int64_t deadline = LockedUntilUs_ != 0 ? LockedUntilUs_ : NoDeadline;
+    if (Level_) {
+        deadline = std::min(deadline, Holding_ ? NextStepUs_ : PressedAtUs_ + HoldUs);
+        if (ResetWindow_ == 0) {
+            deadline = std::min(deadline, PressedAtUs_ + ResetWindowBeginUs);
+        } else if (ResetWindow_ == 1) {
+            deadline = std::min(deadline, PressedAtUs_ + ResetWindowEndUs);
+        }
+    }
+    return deadline;
+}
+
+void TGestureRecognizer::Accept(bool pressed, int64_t timeUs) {
+    Level_ = pressed;
+    LockedUntilUs_ = timeUs + DebounceUs;
+    if (pressed) {
+        PressedAtUs_ = timeUs;
+        SecondPress_ = ClickedAtUs_ != 0 && timeUs - ClickedAtUs_ <= DoubleClickUs;
+        Holding_ = false;
+        ResetWindow_ = 0;
+        return;
+    }
+
+    if (Holding_) {
+        Holding_ = false;
+        ClickedAtUs_ = 0;
+        Emit(EGesture::HoldEnd, timeUs);
+        if (ResetWindow_ == 1) {
+            Emit(EGesture::Reset, timeUs);
+        }
+    } else if (timeUs - PressedAtUs_ < MinPressUs) {
+        return;
+    } else if (SecondPress_) {
+        ClickedAtUs_ = 0;
+        Emit(EGesture::DoubleClick, timeUs);
+    } else {
+        ClickedAtUs_ = timeUs;
+        Emit(EGesture::Click, timeUs);
+    }
+}
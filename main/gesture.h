@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+
+enum class EGesture : uint8_t {
+    // Fires at the release, a double click is a click and then a double click
+    Click,
+    DoubleClick,
+    HoldBegin,
+    // Every RampStepUs while the button is held
+    HoldStep,
+    HoldEnd,
+    ResetWindowBegin,
+    ResetWindowEnd,
+    // A release inside the reset window, after the HoldEnd
+    Reset,
+};
+
+// Turns the raw edges of the button into gestures. The edges carry the microseconds of the
+// interrupt, so the recognizer only knows the time it is told and replays a recorded trace
+// the same way as the real button.
+//
+// The debounce takes the first edge at once and ignores the bounces for DebounceUs, then it
+// catches up with the level the contact has settled at. So a release is a click as soon as it
+// happens, not after a quiet period.
+class TGestureRecognizer {
+public:
+    using TCallback = void (*)(void* arg, EGesture gesture, int64_t timeUs);
+
+    static constexpr int64_t NoDeadline = std::numeric_limits<int64_t>::max();
+
+    static constexpr int64_t DebounceUs = 20000;
+    // A shorter press is a glitch
+    static constexpr int64_t MinPressUs = 30000;
+    // From the release of a click to the press of the second one
+    static constexpr int64_t DoubleClickUs = 300000;
+    static constexpr int64_t HoldUs = 500000;
+    static constexpr int64_t RampStepUs = 50000;
+    static constexpr int64_t ResetWindowBeginUs = 9000000;
+    static constexpr int64_t ResetWindowEndUs = 12000000;
+
+    TGestureRecognizer(TCallback callback, void* arg) : Callback_(callback), Arg_(arg) {
+    }
+
+    // A raw edge, pressed is the level of the contact. Edges must come in the order of the time.
+    void Edge(bool pressed, int64_t timeUs);
+    // Fires what is due by now. Returns when it has to be called next, NoDeadline when only
+    // an edge can change anything.
+    int64_t Advance(int64_t nowUs);
+
+    [[nodiscard]] bool Pressed() const {
+        return Level_;
+    }
+
+private:
+    void Accept(bool pressed, int64_t timeUs);
+    void Emit(EGesture gesture, int64_t timeUs) {
+        Callback_(Arg_, gesture, timeUs);
+    }
+
+private:
+    TCallback Callback_;
+    void* Arg_;
+    // The debounced level and the last raw one
+    bool Level_ = false;
+    bool RawLevel_ = false;
+    int64_t RawTimeUs_ = 0;
+    // End of the debounce, 0 when the edges are taken at once
+    int64_t LockedUntilUs_ = 0;
+    int64_t PressedAtUs_ = 0;
+    // Release of the last click, 0 when the next press can't make a double click
+    int64_t ClickedAtUs_ = 0;
+    bool SecondPress_ = false;
+    bool Holding_ = false;
+    int64_t NextStepUs_ = 0;
+    // 0 before the reset window, 1 in it and 2 after it
+    uint8_t ResetWindow_ = 0;
+};
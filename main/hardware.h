@@ -1,7 +1,16 @@
 #pragma once
+#include <array>
 #include <driver/gpio.h>
 
 static constexpr gpio_num_t Led = GPIO_NUM_2;
 static constexpr gpio_num_t Button = GPIO_NUM_4;
-static constexpr gpio_num_t Output = GPIO_NUM_14;
-//static constexpr gpio_num_t Output = GPIO_NUM_5;
+// Garland strands in the order of the output channels, the first one is the original output.
+// The last two are boot strapping pins, CONFIG_OUTPUT_STRAPPING_PINS allows them.
+static constexpr std::array<gpio_num_t, 6> Outputs = {
+    GPIO_NUM_14,
+    GPIO_NUM_12,
+    GPIO_NUM_13,
+    GPIO_NUM_5,
+    GPIO_NUM_15,
+    GPIO_NUM_0,
+};
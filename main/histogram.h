@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Counts values in power of two buckets: bucket 0 takes the values below 2^Shift, bucket i
+// the values in [2^(Shift + i - 1), 2^(Shift + i)) and the last one everything above.
+// Adding is a few instructions, so it is cheap enough to stay always on.
+template<uint8_t Shift, size_t Size = 8>
+class THistogram {
+public:
+    static_assert(Size >= 2);
+
+    void Add(uint32_t value) {
+        auto scaled = value >> Shift;
+        size_t bucket = scaled == 0 ? 0 : 32 - __builtin_clz(scaled);
+        ++Buckets_[bucket < Size ? bucket : Size - 1];
+        ++Count_;
+        Sum_ += value;
+        if (value > Max_) {
+            Max_ = value;
+        }
+    }
+
+    [[nodiscard]] const std::array<uint32_t, Size>& Buckets() const {
+        return Buckets_;
+    }
+
+    [[nodiscard]] uint32_t Count() const {
+        return Count_;
+    }
+
+    [[nodiscard]] uint32_t Mean() const {
+        return Count_ == 0 ? 0 : static_cast<uint32_t>(Sum_ / Count_);
+    }
+
+    [[nodiscard]] uint32_t Max() const {
+        return Max_;
+    }
+
+private:
+    std::array<uint32_t, Size> Buckets_{};
+    uint32_t Count_ = 0;
+    uint32_t Max_ = 0;
+    uint64_t Sum_ = 0;
+};
@@ -1,58 +1,47 @@
 #include "led.h"
-#include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
-#include <freertos/task.h>
-#include <array>
-#include <esp_log.h>
-extern "C" {
-#include <esp_task_wdt.h>
-}
+#include "registry.h"
+
+static constexpr uint16_t StepMs = 100;
 
-static QueueHandle_t LedQueue;
+static constexpr TLedPattern Provisioning = TLedPattern::FromBits(0xff00, StepMs, true);
+// Three short flashes
+static constexpr TLedPattern Error = TLedPattern::FromBits(0xa800, StepMs, false);
 
-void LedSet(ELedState state) {
-    xQueueSend(LedQueue, &state, 5);
+static constexpr auto Previews = [] {
+    std::array<TLedPattern, ModeCount> patterns{};
+    for (size_t i = 0; i < ModeCount; ++i) {
+        patterns[i] = TLedPattern::FromBits(ModeInfos[i].LedPattern, StepMs, false);
+    }
+    return patterns;
+}();
+
+// The LED is on at the low level
+static void SetLed(void*, bool on) {
+    gpio_set_level(Led, on ? 0 : 1);
 }
 
-std::array<uint16_t, 5> Patterns = {
-        0xff00,
-        0x8000,
-        0xb800,
-        0xbb80,
-        0xbbb8
-};
+static TLedEngine Engine(SetLed, nullptr);
 
-static_assert(static_cast<size_t>(ELedState::Candle) - static_cast<size_t>(ELedState::Sta) == Patterns.size() - 1);
+void LedShow(ELedIndication indication) {
+    switch (indication) {
+        case ELedIndication::Provisioning:
+            Engine.Show(indication, &Provisioning);
+            break;
+        case ELedIndication::Error:
+            Engine.Show(indication, &Error);
+            break;
+        default:
+            Engine.Show(indication, &LedSteadyOn);
+    }
+}
+
+void LedClear(ELedIndication indication) {
+    Engine.Clear(indication);
+}
 
-[[noreturn]] void LedTask(void*) {
-    ELedState persistent = ELedState::Off;
-    ELedState state = ELedState::Off;
-    uint32_t offset = 0;
-    while (true) {
-        esp_task_wdt_reset();
-        ELedState cmd;
-        if (xQueueReceive(LedQueue, &cmd, 100) == pdTRUE) {
-            if (cmd == ELedState::Off || cmd == ELedState::Sta || cmd == ELedState::On) {
-                persistent = cmd;
-            }
-            state = cmd;
-            offset = 0;
-        }
-        if (state == ELedState::On) {
-            gpio_set_level(Led, 0);
-        } else if (state == ELedState::Off) {
-            gpio_set_level(Led, 1);
-        } else {
-            bool level = !(Patterns[static_cast<uint32_t>(state) - static_cast<uint32_t>(ELedState::Sta)] << offset & 0x8000);
-            gpio_set_level(Led, (persistent == ELedState::On) == !level);
-        }
-        if (++offset == 16) {
-            if (state == ELedState::Sta) {
-                offset = 0;
-            } else {
-                state = persistent;
-            }
-        }
+void LedPreviewMode(size_t mode) {
+    if (mode < Previews.size()) {
+        Engine.Show(ELedIndication::ModePreview, &Previews[mode]);
     }
 }
 
@@ -65,7 +54,6 @@ void LedInit() {
         GPIO_INTR_DISABLE
     };
     gpio_config(&outputConf);
-
-    LedQueue = xQueueCreate(6, sizeof(ELedState));
-    xTaskCreate(LedTask, "LedTask", 256, nullptr, 5, nullptr);
+    SetLed(nullptr, false);
+    Engine.Init();
 }
@@ -1,15 +1,11 @@
 #pragma once
+#include <cstddef>
 #include "hardware.h"
-
-enum class ELedState {
-        On,
-        Off,
-        Sta,
-        Static,
-        Dynamic,
-        Fireplace,
-        Candle,
-};
+#include "led_engine.h"
 
 void LedInit();
-void LedSet(ELedState state);
\ No newline at end of file
+// Connecting, provisioning and the reset window stay until they are cleared, the others play once
+void LedShow(ELedIndication indication);
+void LedClear(ELedIndication indication);
+// Plays the pattern of the mode once, then returns to the indication below it
+void LedPreviewMode(size_t mode);
@@ -0,0 +1,90 @@
+#include "led_engine.h"
+#include "wakeups.h"
+
+#include <esp_err.h>
+
+void TLedEngine::Init() {
+    esp_timer_create_args_t timerArgs{};
+    timerArgs.callback = OnTimer;
+    timerArgs.arg = this;
+    timerArgs.name = "led";
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &Timer_))
+}
+
+void TLedEngine::Show(ELedIndication indication, const TLedPattern* pattern) {
+    auto slot = static_cast<size_t>(indication);
+    ++Generations_[slot];
+    Patterns_[slot] = pattern;
+    Kick();
+}
+
+void TLedEngine::Clear(ELedIndication indication) {
+    if (Patterns_[static_cast<size_t>(indication)].exchange(nullptr) != nullptr) {
+        Kick();
+    }
+}
+
+// The change is picked up in the esp_timer task right away
+void TLedEngine::Kick() {
+    Dirty_ = true;
+    esp_timer_stop(Timer_);
+    esp_timer_start_once(Timer_, 0);
+}
+
+void TLedEngine::OnTimer(void* arg) {
+    static_cast<TLedEngine*>(arg)->Update();
+}
+
+void TLedEngine::Update() {
+    NWakeups::Count(EWakeSource::Led);
+    auto now = esp_timer_get_time();
+    bool dirty = Dirty_.exchange(false);
+    while (true) {
+        size_t top = Slots;
+        for (size_t i = Slots; i-- > 0;) {
+            if (Patterns_[i].load() != nullptr) {
+                top = i;
+                break;
+            }
+        }
+        if (top == Slots) {
+            Shown_ = ELedIndication::Count;
+            Setter_(Arg_, false);
+            return;
+        }
+        auto pattern = Patterns_[top].load();
+        auto generation = Generations_[top].load();
+        auto indication = static_cast<ELedIndication>(top);
+        if (indication != Shown_ || generation != ShownGeneration_) {
+            Shown_ = indication;
+            ShownGeneration_ = generation;
+            Run_ = 0;
+        } else if (RunEndUs_ == 0) {
+            // The run holds, there is nothing to step
+            return;
+        } else if (dirty && RunEndUs_ > now) {
+            // A change of a lower indication stopped the timer, the current run goes on
+            esp_timer_start_once(Timer_, RunEndUs_ - now);
+            return;
+        } else if (++Run_ == pattern->Count) {
+            Run_ = 0;
+            if (!pattern->Repeat) {
+                // Unless it was shown again in the meantime
+                if (Generations_[top].load() == generation) {
+                    Patterns_[top].compare_exchange_strong(pattern, nullptr);
+                }
+                continue;
+            }
+        }
+
+        auto& run = pattern->Runs[Run_];
+        Setter_(Arg_, run.On);
+        if (run.Ms == 0) {
+            RunEndUs_ = 0;
+            return;
+        }
+        RunEndUs_ = now + run.Ms * 1000;
+        esp_timer_start_once(Timer_, run.Ms * 1000);
+        return;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <esp_timer.h>
+
+// What the status LED tells. A later one covers the earlier ones while it lasts.
+enum class ELedIndication : uint8_t {
+    Connecting,
+    Provisioning,
+    ModePreview,
+    Error,
+    ResetWindow,
+    Count,
+};
+
+// The LED is on or off for Ms milliseconds, 0 holds it until the indication changes
+struct TLedRun {
+    bool On;
+    uint16_t Ms;
+};
+
+// Run-length encoded pattern. A pattern that doesn't repeat ends its indication after the last run.
+struct TLedPattern {
+    static constexpr size_t MaxRuns = 16;
+
+    std::array<TLedRun, MaxRuns> Runs{};
+    uint8_t Count = 0;
+    bool Repeat = false;
+
+    // The 16 steps of the bits, MSB first, like the patterns of the modes
+    static constexpr TLedPattern FromBits(uint16_t bits, uint16_t stepMs, bool repeat) {
+        TLedPattern pattern;
+        pattern.Repeat = repeat;
+        for (int i = 15; i >= 0; --i) {
+            bool on = (bits >> i & 1) != 0;
+            if (pattern.Count > 0 && pattern.Runs[pattern.Count - 1].On == on) {
+                pattern.Runs[pattern.Count - 1].Ms += stepMs;
+            } else {
+                pattern.Runs[pattern.Count++] = {on, stepMs};
+            }
+        }
+        return pattern;
+    }
+};
+
+inline constexpr TLedPattern LedSteadyOn{{{{true, 0}}}, 1, false};
+
+// Steps the patterns in a one-shot esp_timer that is armed only until the end of the current run,
+// so a steady or dark LED costs nothing. Every indication has its slot and the highest active one
+// is shown; the lower one starts over when it ends. Show() and Clear() can be called from any task
+// and never block, the LED itself is only set in the esp_timer task.
+class TLedEngine {
+public:
+    using TSetter = void (*)(void* arg, bool on);
+
+    TLedEngine(TSetter setter, void* arg) : Setter_(setter), Arg_(arg) {
+    }
+
+    void Init();
+    // The pattern must outlive the indication. Showing the same indication again starts it over.
+    void Show(ELedIndication indication, const TLedPattern* pattern);
+    void Clear(ELedIndication indication);
+
+    // Count while the LED is dark
+    [[nodiscard]] ELedIndication Shown() const {
+        return Shown_;
+    }
+
+private:
+    static void OnTimer(void* arg);
+    void Kick();
+    void Update();
+
+    static constexpr size_t Slots = static_cast<size_t>(ELedIndication::Count);
+
+private:
+    TSetter Setter_;
+    void* Arg_;
+    esp_timer_handle_t Timer_ = nullptr;
+    // Null when the indication is not active
+    std::array<std::atomic<const TLedPattern*>, Slots> Patterns_{};
+    std::array<std::atomic<uint32_t>, Slots> Generations_{};
+    std::atomic<bool> Dirty_{false};
+    std::atomic<ELedIndication> Shown_{ELedIndication::Count};
+    // Touched only in the esp_timer task
+    uint32_t ShownGeneration_ = 0;
+    uint8_t Run_ = 0;
+    // 0 while the run holds
+    int64_t RunEndUs_ = 0;
+};
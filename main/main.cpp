@@ -11,55 +11,225 @@
 #include <nvs_flash.h>
 #include <esp_netif.h>
 #include <esp_event.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
 extern "C" {
 #include <esp_task_wdt.h>
 }
 
 #include "captive.h"
+#include "connectivity.h"
 #include "network.h"
 #include "mqtt.h"
-#include "modes.h"
+#include "registry.h"
 #include "config.h"
 #include "led.h"
 #include "button.h"
 #include "output.h"
+#include "state_publisher.h"
+#include "command.h"
+#include "cycles.h"
+#include "pixels.h"
+#include "ws2812.h"
 #include "private.h"
 
 static const char *TAG = "CRISTMAS_LED";
 static TStorage ConfigStorage;
+static TConfigStore Config(&ConfigStorage);
+static TStorage StateStorage;
 
-class TController : public IMqttCallback, public INetworkCallback, public IButtonCallback, public IOutputCallback {
-public:
-    TController() : MqttClient_(MqttServer, MqttLogin, MqttPassword, this), Connected_(false) {
+static constexpr std::string_view StateKey = "state";
+// Changes with the layout of the blob, an old state is ignored
+static constexpr char StateVersion = 2;
+
+static constexpr std::string_view ControlTopic = "/alexx/christmas_led/control";
+static constexpr std::string_view ChannelTopicPrefix = "/alexx/christmas_led/";
+static constexpr std::string_view ChannelTopicSuffix = "/control";
+
+// Parses /alexx/christmas_led/control and /alexx/christmas_led/<n>/control
+static bool ParseControlTopic(std::string_view topic, uint8_t& channel) {
+    if (topic == ControlTopic) {
+        channel = AllChannels;
+        return true;
+    }
+    if (topic.size() <= ChannelTopicPrefix.size() + ChannelTopicSuffix.size()
+        || topic.substr(0, ChannelTopicPrefix.size()) != ChannelTopicPrefix
+        || topic.substr(topic.size() - ChannelTopicSuffix.size()) != ChannelTopicSuffix) {
+        return false;
+    }
+    auto number = topic.substr(ChannelTopicPrefix.size(), topic.size() - ChannelTopicPrefix.size() - ChannelTopicSuffix.size());
+    size_t value = 0;
+    for (char ch : number) {
+        if (ch < '0' || ch > '9') {
+            return false;
+        }
+        value = value * 10 + (ch - '0');
+        if (value >= OutputChannels) {
+            return false;
+        }
     }
+    channel = static_cast<uint8_t>(value);
+    return true;
+}
 
-    void OnWifiConnected(const tcpip_adapter_ip_info_t& info) override {
-        ESP_LOGI(TAG, "Wifi Connected");
-        MqttClient_.Start();
+static std::string StateTopic(size_t channel) {
+    if (OutputChannels == 1) {
+        return "/alexx/led/state";
     }
+    return "/alexx/led/" + std::to_string(channel) + "/state";
+}
 
-    void OnWifiDisconnected() override {
-        ESP_LOGI(TAG, "MQTT Disconnected");
-        LedSet(ELedState::On);
-        Connected_ = false;
-        MqttClient_.Stop();
+static constexpr std::string_view StatsTopic = "/alexx/led/stats";
+// Percent of the brightness per step of the ramp of the button, a step is 50 ms
+static constexpr uint8_t RampStep = 2;
+static constexpr uint8_t MinBrightness = 4;
+
+template<uint8_t Shift, size_t Size>
+static void AppendHistogram(std::string& out, const char* name, const THistogram<Shift, Size>& histogram) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), ",\"%s\":{\"n\":%u,\"mean\":%u,\"max\":%u,\"hist\":[",
+             name, histogram.Count(), histogram.Mean(), histogram.Max());
+    out += buffer;
+    for (size_t i = 0; i < Size; ++i) {
+        snprintf(buffer, sizeof(buffer), i == 0 ? "%u" : ",%u", histogram.Buckets()[i]);
+        out += buffer;
+    }
+    out += "]}";
+}
+
+// In hundredths, so it prints with two decimals without the float formatting
+static uint32_t PerSecond100(uint32_t count, uint32_t periodMs) {
+    return periodMs == 0 ? 0 : static_cast<uint32_t>(static_cast<uint64_t>(count) * 100000 / periodMs);
+}
+
+static void AppendWakeups(std::string& out, const TOutputReport& report) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), ",\"idle_ms\":%u,\"wakeups\":{", report.IdleMs);
+    out += buffer;
+    for (size_t i = 0; i < report.Wakeups.size(); ++i) {
+        auto rate = PerSecond100(report.Wakeups[i], report.PeriodMs);
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":%u.%02u", i == 0 ? "" : ",", WakeSourceNames[i].data(), rate / 100, rate % 100);
+        out += buffer;
+    }
+    out += "}";
+}
+
+// Compact JSON, the jitter is in microseconds, the costs are in CPU cycles, the wake ups are per second
+static std::string FormatReport(const TOutputReport& report, uint32_t suppressed, const TConnectivityStats& network) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "{\"frames\":%u,\"missed\":%u,\"underruns\":%u,\"first_light_ms\":%u,\"mhz\":%u,\"worst\":%u,\"suppressed\":%u"
+             ",\"wifi_reconnects\":%u,\"mqtt_reconnects\":%u,\"recovery_ms\":%u,\"max_recovery_ms\":%u",
+             report.Totals.Frames, report.Totals.MissedDeadlines, report.Totals.Underruns, report.Totals.FirstLightUs / 1000,
+             NCycles::PerUs, report.WorstFrame, suppressed, network.WifiReconnects, network.MqttReconnects,
+             network.LastRecoveryMs, network.MaxRecoveryMs);
+    std::string out = buffer;
+    AppendWakeups(out, report);
+    AppendHistogram(out, "jitter", report.Jitter);
+    for (size_t i = 0; i < report.StepCost.size(); ++i) {
+        if (report.StepCost[i].Count() != 0) {
+            AppendHistogram(out, ModeInfos[i].Name.data(), report.StepCost[i]);
+        }
+    }
+    out += "}";
+    return out;
+}
+
+// Version, number of channels and number of modes, then every channel: on, mode, brightness,
+// fade and the speed and intensity of every mode. Little endian, without padding, so the blob
+// doesn't depend on the compiler and a change of the number of channels or modes is not read.
+static constexpr size_t StateHeaderSize = 3;
+static constexpr size_t ChannelStateSize = 5 + ModeCount * 3;
+
+static std::string EncodeState(const TOutputSnapshot& snapshot) {
+    std::string blob;
+    blob.reserve(StateHeaderSize + OutputChannels * ChannelStateSize);
+    auto put16 = [&blob](uint16_t value) {
+        blob += static_cast<char>(value);
+        blob += static_cast<char>(value >> 8);
+    };
+    blob += StateVersion;
+    blob += static_cast<char>(OutputChannels);
+    blob += static_cast<char>(ModeCount);
+    for (const auto& channel : snapshot) {
+        blob += static_cast<char>(channel.IsOn ? 1 : 0);
+        blob += static_cast<char>(channel.Mode);
+        blob += static_cast<char>(channel.Brightness);
+        put16(channel.Fade);
+        for (const auto& params : channel.Params) {
+            put16(params.Speed);
+            blob += static_cast<char>(params.Intensity);
+        }
+    }
+    return blob;
+}
+
+static bool DecodeState(std::string_view blob, TOutputSnapshot& snapshot) {
+    if (blob.size() != StateHeaderSize + OutputChannels * ChannelStateSize || blob[0] != StateVersion
+        || static_cast<uint8_t>(blob[1]) != OutputChannels || static_cast<uint8_t>(blob[2]) != ModeCount) {
+        return false;
+    }
+    auto data = reinterpret_cast<const uint8_t*>(blob.data()) + StateHeaderSize;
+    auto get16 = [&data]() {
+        auto value = static_cast<uint16_t>(data[0] | data[1] << 8);
+        data += 2;
+        return value;
+    };
+    for (auto& channel : snapshot) {
+        if (data[0] > 1) {
+            return false;
+        }
+        channel.IsOn = data[0] == 1;
+        channel.Mode = data[1];
+        channel.Brightness = data[2];
+        data += 3;
+        channel.Fade = get16();
+        for (auto& params : channel.Params) {
+            params.Speed = get16();
+            params.Intensity = *data++;
+        }
+    }
+    return true;
+}
+
+class TController : public IMqttCallback, public IButtonCallback, public IOutputCallback {
+public:
+    TController()
+        : Connectivity_(MqttServer, MqttLogin, MqttPassword, this)
+        , Connected_(false)
+        , StatePublisher_(CONFIG_STATE_PUBLISH_INTERVAL_MS, PublishState, this) {
+    }
+
+    void Connect(TConfigStore* config) {
+        Connectivity_.Start(config);
     }
 
     void OnMqttConnected(const TMqttClient& client) override {
-        ESP_LOGI(TAG, "MQTT Connected");
+        auto timings = WifiTimings();
+        ESP_LOGI(TAG, "MQTT Connected, %s association %lld ms, DHCP %lld ms, MQTT %lld ms, %lld ms since the boot",
+                 timings.Directed ? "directed" : "scan", (timings.AssociatedUs - timings.StartUs) / 1000,
+                 (timings.GotIpUs - timings.AssociatedUs) / 1000, (esp_timer_get_time() - timings.GotIpUs) / 1000,
+                 esp_timer_get_time() / 1000);
         client.Subscribe("/alexx/christmas_led/state");
         client.Subscribe("/alexx/christmas_led/control");
+        if (OutputChannels > 1) {
+            client.Subscribe("/alexx/christmas_led/+/control");
+        }
     }
 
     void OnMqttDisconnected(const TMqttClient& client) override {
         ESP_LOGI(TAG, "MQTT Disconnected");
-        LedSet(ELedState::On);
+        LedShow(ELedIndication::Connecting);
         Connected_ = false;
     }
 
     void OnMqttSubscribed(const TMqttClient& client, std::string_view topic) override {
         ESP_LOGI(TAG, "MQTT Subscribed");
-        LedSet(ELedState::Off);
+        LedClear(ELedIndication::Connecting);
         Connected_ = true;
         if (topic == "/alexx/led/state") {
             client.Publish(topic, "off");
@@ -71,31 +241,21 @@ public:
     }
 
     void OnMqttData(const TMqttClient& client, std::string_view topic, std::string_view data) override {
-        if (topic != "/alexx/christmas_led/control") {
+        uint8_t channel;
+        if (!ParseControlTopic(topic, channel)) {
             return;
         }
-        if (data == "on" || data == "true" || data == "1") {
-            ESP_LOGI(TAG, "Switch On by MQTT");
-            OutputSet(EOutputState::On);
-        } else if (data == "off" || data == "false" || data == "0") {
-            ESP_LOGI(TAG, "Switch Off by MQTT");
-            OutputSet(EOutputState::Off);
-        } else if (data == "toggle") {
-            ESP_LOGI(TAG, "Toggle by MQTT");
-            OutputSet(EOutputState::Toggle);
-        } else if (data == "static") {
-            ESP_LOGI(TAG, "Static mode by MQTT");
-            OutputSet(EOutputState::Static);
-        } else if (data == "dynamic") {
-            ESP_LOGI(TAG, "Dynamic mode by MQTT");
-            OutputSet(EOutputState::Dynamic);
-        } else if (data == "fireplace") {
-            ESP_LOGI(TAG, "Fireplace mode by MQTT");
-            OutputSet(EOutputState::Fireplace);
-        } else if (data == "candle") {
-            ESP_LOGI(TAG, "Candle mode by MQTT");
-            OutputSet(EOutputState::Candle);
+        TCommand command;
+        command.Channel = channel;
+        if (!ParseCommand(data, command)) {
+            ESP_LOGW(TAG, "Invalid command: %.*s", static_cast<int>(data.size()), data.data());
+            return;
         }
+        ESP_LOGI(TAG, "Command by MQTT: %.*s", static_cast<int>(data.size()), data.data());
+        if (command.Brightness && (channel == AllChannels || channel == 0)) {
+            Brightness_ = *command.Brightness;
+        }
+        OutputSet(command);
     }
 
     void OnButtonToggle() override {
@@ -105,56 +265,163 @@ public:
 
     void OnButtonNext() override {
         ESP_LOGI(TAG, "Next mode by button");
-        OutputSet(EOutputState::Next);
+        OutputSet(EOutputState::NextOn);
+    }
+
+    // Every hold goes the other way, unless the brightness is already at that end
+    void OnButtonRampBegin() override {
+        auto brightness = Brightness_.load();
+        RampUp_ = brightness <= MinBrightness || (brightness < 100 && !RampUp_);
+        ESP_LOGI(TAG, "Brightness ramp %s from %d%% by button", RampUp_ ? "up" : "down", brightness);
+    }
+
+    void OnButtonRampStep() override {
+        auto brightness = Brightness_.load();
+        auto next = RampUp_ ? std::min<int>(brightness + RampStep, 100) : std::max<int>(brightness - RampStep, MinBrightness);
+        if (next == brightness) {
+            return;
+        }
+        Brightness_ = static_cast<uint8_t>(next);
+        TCommand command;
+        command.Brightness = static_cast<uint8_t>(next);
+        OutputSet(command);
     }
 
     void OnButtonResetWindowBegin() override {
         ESP_LOGI(TAG, "Waiting reset...");
-        LedSet(ELedState::On);
+        LedShow(ELedIndication::ResetWindow);
     }
 
     void OnButtonResetWindowEnd() override {
         ESP_LOGI(TAG, "Ready to reset...");
-        LedSet(ELedState::Off);
+        LedClear(ELedIndication::ResetWindow);
     }
 
     void OnButtonReset() override {
         ESP_LOGI(TAG, "Erase and reset");
-        ConfigStorage.Erase();
+        Config.Erase();
+        StateStorage.Erase();
         esp_restart();
     }
 
-    void OnOutputChanged(bool isOn, size_t mode) override {
-        if (Connected_) {
-            if (isOn && mode == 0) {
-                ESP_LOGI(TAG, "Switched to static");
-                MqttClient_.Publish("/alexx/led/state", "on");
-            } else if (isOn && mode == 1) {
-                ESP_LOGI(TAG, "Switched to dynamic");
-                MqttClient_.Publish("/alexx/led/state", "dynamic");
-            } else if (isOn && mode == 2) {
-                ESP_LOGI(TAG, "Switched to fireplace");
-                MqttClient_.Publish("/alexx/led/state", "fireplace");
-            } else if (isOn && mode == 3) {
-                ESP_LOGI(TAG, "Switched to candle");
-                MqttClient_.Publish("/alexx/led/state", "candle");
-            } else {
-                ESP_LOGI(TAG, "Switched off");
-                MqttClient_.Publish("/alexx/led/state", "off");
-            }
+    void OnOutputChanged(size_t channel, bool isOn, size_t mode) override {
+        if (isOn) {
+            ESP_LOGI(TAG, "Channel %d switched to %s", channel, ModeInfos[mode].Name.data());
+        } else {
+            ESP_LOGI(TAG, "Channel %d switched off", channel);
+        }
+        StatePublisher_.Update(channel, isOn, mode);
+#ifdef CONFIG_PIXEL_OUTPUT
+        if (channel == 0) {
+            PixelSet(isOn, mode);
         }
+#endif
         if (isOn) {
-            LedSet(static_cast<ELedState>(mode + static_cast<size_t>(ELedState::Static)));
+            LedPreviewMode(mode);
         }
     }
 
+    // Runs in the OutputTask. The JSON and the publish are left to the ReportTask, like the save.
+    void OnOutputReport(const TOutputReport& report) override {
+        xQueueOverwrite(ReportQueue_, &report);
+    }
+
+    // Runs in the OutputTask. An erase of the flash stalls for longer than the frame ring lasts,
+    // so the write is left to the SaveTask below it. Only the latest snapshot is kept.
+    void OnOutputSave(const TOutputSnapshot& snapshot) override {
+        xQueueOverwrite(SaveQueue_, &snapshot);
+    }
+
+    // Runs in the OutputTask
+    void OnOutputIdle(bool idle) override {
+        ESP_LOGI(TAG, idle ? "Output idle" : "Output active");
+        SetWifiSleep(idle);
+    }
+
+    // Before the OutputTask starts, the slow work of its callbacks runs in these tasks below it
+    void StartTasks() {
+        SaveQueue_ = xQueueCreate(1, sizeof(TOutputSnapshot));
+        xTaskCreate(SaveTask, "SaveTask", 3072, this, 1, nullptr);
+        ReportQueue_ = xQueueCreate(1, sizeof(TOutputReport));
+        xTaskCreate(ReportTask, "ReportTask", 3072, this, 1, nullptr);
+        StatePublisher_.Start();
+    }
+
+    void SetSavedState(std::string blob) {
+        SavedState_ = std::move(blob);
+    }
+
+    // Where the ramp of the button starts after a restart
+    void SetBrightness(uint8_t brightness) {
+        Brightness_ = brightness;
+    }
+
 private:
-    TMqttClient MqttClient_;
-    bool Connected_;
+    // The same state is not written twice
+    [[noreturn]] static void SaveTask(void* arg) {
+        auto self = static_cast<TController*>(arg);
+        TOutputSnapshot snapshot;
+        while (true) {
+            xQueueReceive(self->SaveQueue_, &snapshot, portMAX_DELAY);
+            auto blob = EncodeState(snapshot);
+            if (blob == self->SavedState_) {
+                continue;
+            }
+            if (!StateStorage.Set(StateKey, blob) || !StateStorage.Commit()) {
+                ESP_LOGW(TAG, "Can't save the output state");
+                LedShow(ELedIndication::Error);
+                continue;
+            }
+            self->SavedState_ = std::move(blob);
+        }
+    }
+
+    [[noreturn]] static void ReportTask(void* arg) {
+        auto self = static_cast<TController*>(arg);
+        TOutputReport report;
+        while (true) {
+            xQueueReceive(self->ReportQueue_, &report, portMAX_DELAY);
+            auto suppressed = self->StatePublisher_.Suppressed();
+            uint32_t wakeups = 0;
+            for (auto count : report.Wakeups) {
+                wakeups += count;
+            }
+            auto rate = PerSecond100(wakeups, report.PeriodMs);
+            ESP_LOGI(TAG, "Frames %u, missed %u, underruns %u, worst frame %u cycles, first light %u ms, suppressed %u states, "
+                     "idle %u ms of %u, %u.%02u wake-ups/s",
+                     report.Totals.Frames, report.Totals.MissedDeadlines, report.Totals.Underruns, report.WorstFrame,
+                     report.Totals.FirstLightUs / 1000, suppressed, report.IdleMs, report.PeriodMs, rate / 100, rate % 100);
+            if (self->Connected_) {
+                self->Connectivity_.Mqtt().Publish(StatsTopic, FormatReport(report, suppressed, self->Connectivity_.Stats()));
+            }
+        }
+    }
+
+    // Runs in the StateTask of the publisher
+    static bool PublishState(void* arg, size_t channel, bool isOn, uint8_t mode) {
+        auto self = static_cast<TController*>(arg);
+        if (!self->Connected_) {
+            return false;
+        }
+        self->Connectivity_.Mqtt().Publish(StateTopic(channel), isOn ? ModeInfos[mode].State : "off");
+        return true;
+    }
+
+private:
+    TConnectivity Connectivity_;
+    std::atomic<bool> Connected_;
+    TStatePublisher StatePublisher_;
+    // What the button ramps from, it follows the commands by MQTT as well
+    std::atomic<uint8_t> Brightness_{100};
+    bool RampUp_ = true;
+    QueueHandle_t SaveQueue_ = nullptr;
+    QueueHandle_t ReportQueue_ = nullptr;
+    // Touched only by the SaveTask once it runs
+    std::string SavedState_;
 };
 
 static TController Controller;
-static TConfigServer ConfigServer(&ConfigStorage);
+static TConfigServer ConfigServer(&Config);
 
 extern "C" {
 
@@ -167,19 +434,38 @@ extern "C" {
     ESP_ERROR_CHECK(esp_netif_init())
     ESP_ERROR_CHECK(esp_event_loop_create_default())
 
+    // The lights come back before Wi-Fi and MQTT, they don't need the network
+    StateStorage.Init("output");
+    auto savedState = StateStorage.Get(StateKey);
+    TOutputSnapshot snapshot{};
+    bool restored = DecodeState(savedState, snapshot);
+    if (restored) {
+        Controller.SetSavedState(std::move(savedState));
+        Controller.SetBrightness(snapshot[0].Brightness);
+    }
+
     LedInit();
     ButtonInit(&Controller);
-    OutputInit(&Controller);
+    Controller.StartTasks();
+    OutputInit(&Controller, restored ? &snapshot : nullptr);
+#ifdef CONFIG_PIXEL_OUTPUT
+    static TWs2812Sink pixelSink(CONFIG_PIXEL_COUNT);
+    PixelInit(&pixelSink, CONFIG_PIXEL_COUNT);
+    if (restored) {
+        PixelSet(snapshot[0].IsOn, snapshot[0].Mode);
+    }
+#endif
 
     ConfigStorage.Init("config");
+    Config.Load();
     if (ConfigServer.GetSsid().empty()) {
-        LedSet(ELedState::Sta);
+        LedShow(ELedIndication::Provisioning);
         StartSoftAP();
         ConfigServer.Start();
         start_dns_server();
     } else {
-        LedSet(ELedState::On);
-        ConnectWifi(ConfigServer.GetSsid(), ConfigServer.GetPassword(), &Controller);
+        LedShow(ELedIndication::Connecting);
+        Controller.Connect(&Config);
     }
 }
 
@@ -1,14 +1,34 @@
+#pragma once
 #include <cstdint>
-#include <random>
-#include <memory>
+#include <cstddef>
+#include <sdkconfig.h>
+#include "fixed.h"
+#include "random.h"
 
-class IMode {
-public:
-    virtual ~IMode()  = default;
-    virtual double step(std::mt19937& generator) = 0;
+#ifdef CONFIG_MODES_FIXED_POINT
+using TLevel = TFixed;
+#else
+using TLevel = double;
+#endif
+
+enum class EWaveform;
+
+// Runtime parameters of a mode, in percent of the tuned values
+struct TModeParams {
+    uint16_t Speed = 100;
+    uint8_t Intensity = 100;
 };
 
-std::shared_ptr<IMode> CreateStatic();
-std::shared_ptr<IMode> CreateDynamic(uint32_t period);
-std::shared_ptr<IMode> CreateFireplace();
-std::shared_ptr<IMode> CreateCandle();
+// Clamps the level to [0, 1] and applies the gamma of 2 of the output
+inline uint32_t LevelToDuty(TLevel value, uint32_t scale) {
+    if (value > TLevel(1.0)) {
+        value = TLevel(1.0);
+    } else if (value < TLevel(0.0)) {
+        value = TLevel(0.0);
+    }
+#ifdef CONFIG_MODES_FIXED_POINT
+    return (value * value).Scale(scale);
+#else
+    return static_cast<uint32_t>(value * value * scale);
+#endif
+}
@@ -2,22 +2,46 @@
 
 #include <esp_log.h>
 #include <mqtt_client.h>
+#include <sdkconfig.h>
 
 static const char *TAG = "MQTT";
+static constexpr int KeepaliveS = CONFIG_MQTT_KEEPALIVE_S;
 
 static void MqttEventHandler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
 
-void TMqttClient::Start() {
-    esp_mqtt_client_config_t config {
-        .uri = Server_.data(),
-        .username = Username_.data(),
-        .password = Password_.data(),
-        .user_context = static_cast<void *>(Callback_),
-    };
-    Client_ = esp_mqtt_client_init(&config);
-    esp_mqtt_client_register_event(Client_, static_cast<esp_mqtt_event_id_t>(ESP_EVENT_ANY_ID), MqttEventHandler, this);
+bool TMqttClient::Connect() {
+    if (Client_ == nullptr) {
+        esp_mqtt_client_config_t config {
+            .uri = Server_.data(),
+            .username = Username_.data(),
+            .password = Password_.data(),
+            .user_context = static_cast<void *>(Callback_),
+        };
+        // The owner decides when to try again, with its backoff
+        config.disable_auto_reconnect = true;
+        config.keepalive = KeepaliveS;
+        Client_ = esp_mqtt_client_init(&config);
+        esp_mqtt_client_register_event(Client_, static_cast<esp_mqtt_event_id_t>(ESP_EVENT_ANY_ID), MqttEventHandler, this);
+    }
+    if (Running_) {
+        ESP_LOGI(TAG, "Reconnecting...");
+        if (esp_mqtt_client_reconnect(Client_) == ESP_OK) {
+            return true;
+        }
+        ESP_LOGW(TAG, "Can't reconnect, restarting");
+        esp_mqtt_client_stop(Client_);
+        Running_ = false;
+    }
     ESP_LOGI(TAG, "Starting...");
-    esp_mqtt_client_start(Client_);
+    Running_ = esp_mqtt_client_start(Client_) == ESP_OK;
+    return Running_;
+}
+
+void TMqttClient::Disconnect() {
+    if (Client_ != nullptr && Running_.exchange(false)) {
+        ESP_LOGI(TAG, "Stopping after the loss of the link");
+        esp_mqtt_client_stop(Client_);
+    }
 }
 
 void TMqttClient::Stop() {
@@ -26,6 +50,7 @@ void TMqttClient::Stop() {
         esp_mqtt_client_stop(Client_);
         esp_mqtt_client_destroy(Client_);
         Client_ = nullptr;
+        Running_ = false;
         ESP_LOGI(TAG, "Stopped");
     }
 }
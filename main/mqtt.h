@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <utility>
 #include <vector>
 #include <string>
@@ -24,13 +25,19 @@ public:
         : Server_(std::move(server)), Username_(std::move(username)), Password_(std::move(password)), Callback_(callback) {
     }
     ~TMqttClient();
-    void Start();
+    // Creates the client on the first call, starts it when it is stopped and reconnects it when it
+    // runs. A client that refuses to reconnect is stopped and started again. Returns false when
+    // it could not be started at all.
+    bool Connect();
+    // Stops the client when the link is gone, so the next Connect() begins from a known state
+    void Disconnect();
     void Stop();
     void Publish(std::string_view topic, std::string_view data) const;
     void Subscribe(std::string_view topic) const;
 
 private:
     esp_mqtt_client_handle_t Client_{nullptr};
+    std::atomic<bool> Running_{false};
     std::string Server_;
     std::string Username_;
     std::string Password_;
@@ -3,28 +3,93 @@
 #include <esp_system.h>
 #include <esp_log.h>
 #include <esp_event.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
+#include <atomic>
 
 static const char *TAG = "NETWORK";
 static std::string_view ApSsid = "christmas_led";
 
+static TConfigStore* Config;
+static wifi_config_t StaConfig;
+static TWifiTimings Timings;
+static std::atomic<bool> Started{false};
+static std::atomic<bool> Sleep{false};
+// In beacon intervals, the radio wakes for every third beacon in the sleep
+static constexpr uint16_t ListenInterval = 3;
+
+static void ApplySleep() {
+    esp_wifi_set_ps(Sleep ? WIFI_PS_MAX_MODEM : WIFI_PS_NONE);
+}
+
+// The cached access point has gone or changed its channel, the next attempts scan all of them
+static void FallBackToScan() {
+    ESP_LOGI(TAG, "Directed association failed, scanning");
+    Timings.Directed = false;
+    StaConfig.sta.bssid_set = false;
+    StaConfig.sta.channel = 0;
+    esp_wifi_set_config(ESP_IF_WIFI_STA, &StaConfig);
+}
+
+// Remembers the access point of the connection, the flash is written only when it changes
+static void SaveAccessPoint() {
+    wifi_ap_record_t info;
+    if (esp_wifi_sta_get_ap_info(&info) != ESP_OK) {
+        return;
+    }
+    std::string_view bssid(reinterpret_cast<const char*>(info.bssid), sizeof(info.bssid));
+    if (Config->GetString(EConfigKey::Bssid) == bssid && Config->GetInt(EConfigKey::Channel) == info.primary) {
+        return;
+    }
+    auto transaction = Config->Begin();
+    transaction.SetString(EConfigKey::Bssid, bssid);
+    transaction.SetInt(EConfigKey::Channel, info.primary);
+    if (!transaction.Commit()) {
+        ESP_LOGW(TAG, "Can't save the access point");
+    }
+}
+
 static void OnDisconnected(void *arg, esp_event_base_t, int32_t, void *event_data) {
     auto event = static_cast<system_event_sta_disconnected_t *>(event_data);
     auto callback = static_cast<INetworkCallback*>(arg);
 
-    ESP_LOGI(TAG, "Wi-Fi disconnected, trying to reconnect...");
-    callback->OnWifiDisconnected();
+    ESP_LOGI(TAG, "Wi-Fi disconnected, reason %d", event->reason);
 
+    if (Timings.Directed && Timings.GotIpUs == 0) {
+        FallBackToScan();
+    }
     if (event->reason == WIFI_REASON_BASIC_RATE_NOT_SUPPORT) {
         esp_wifi_set_protocol(ESP_IF_WIFI_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N);
     }
-    ESP_ERROR_CHECK(esp_wifi_connect())
+    callback->OnWifiDisconnected();
+}
+
+void ReconnectWifi() {
+    Timings.StartUs = esp_timer_get_time();
+    Timings.AssociatedUs = 0;
+    Timings.GotIpUs = 0;
+    esp_wifi_connect();
+}
+
+void SetWifiSleep(bool sleep) {
+    Sleep = sleep;
+    if (Started) {
+        ApplySleep();
+    }
+}
+
+static void OnConnected(void *arg, esp_event_base_t, int32_t, void *event_data) {
+    Timings.AssociatedUs = esp_timer_get_time();
 }
 
 static void OnGotIp(void *arg, esp_event_base_t, int32_t, void *event_data) {
     auto event = static_cast<ip_event_got_ip_t *>(event_data);
+    Timings.GotIpUs = esp_timer_get_time();
 
-    ESP_LOGI(TAG, "Connected with IPv4: " IPSTR, IP2STR(&event->ip_info.ip));
+    ESP_LOGI(TAG, "Connected with IPv4: " IPSTR ", %s association %lld ms, DHCP %lld ms", IP2STR(&event->ip_info.ip),
+             Timings.Directed ? "directed" : "scan", (Timings.AssociatedUs - Timings.StartUs) / 1000,
+             (Timings.GotIpUs - Timings.AssociatedUs) / 1000);
+    SaveAccessPoint();
 
     auto callback = static_cast<INetworkCallback*>(arg);
     callback->OnWifiConnected(event->ip_info);
@@ -61,23 +126,44 @@ void StartSoftAP() {
     ESP_ERROR_CHECK(esp_wifi_start())
 }
 
-void ConnectWifi(std::string_view ssid, std::string_view password, INetworkCallback* callback) {
+void ConnectWifi(TConfigStore* config, INetworkCallback* callback) {
+    Config = config;
+    Timings = {esp_timer_get_time(), 0, 0, false};
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT()
     ESP_ERROR_CHECK(esp_wifi_init(&cfg))
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA))
+    // The modem doesn't sleep while the access point of the device is up, and nothing serves it here
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA))
 
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &OnDisconnected, static_cast<void*>(callback)))
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &OnConnected, static_cast<void*>(callback)))
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &OnGotIp, static_cast<void*>(callback)))
 
     ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM))
 
-    wifi_config_t staConfig{};
-    std::copy(ssid.begin(), ssid.end(), staConfig.sta.ssid);
-    std::copy(password.begin(), password.end(), staConfig.sta.password);
+    auto ssid = config->GetString(EConfigKey::Ssid);
+    auto password = config->GetString(EConfigKey::Password);
+    auto bssid = config->GetString(EConfigKey::Bssid);
+    auto channel = config->GetInt(EConfigKey::Channel);
+    StaConfig = {};
+    std::copy(ssid.begin(), ssid.end(), StaConfig.sta.ssid);
+    std::copy(password.begin(), password.end(), StaConfig.sta.password);
+    StaConfig.sta.listen_interval = ListenInterval;
+    // Straight to the known access point on its channel, the scan of all channels takes seconds
+    if (bssid.size() == sizeof(StaConfig.sta.bssid) && channel != 0) {
+        std::copy(bssid.begin(), bssid.end(), StaConfig.sta.bssid);
+        StaConfig.sta.bssid_set = true;
+        StaConfig.sta.channel = static_cast<uint8_t>(channel);
+        Timings.Directed = true;
+    }
 
-    ESP_LOGI(TAG, "Connecting to %s...", staConfig.sta.ssid);
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &staConfig))
+    ESP_LOGI(TAG, "Connecting to %.*s, channel %d...", static_cast<int>(ssid.size()), ssid.data(), channel);
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &StaConfig))
     ESP_ERROR_CHECK(esp_wifi_start())
+    Started = true;
+    ApplySleep();
     ESP_ERROR_CHECK(esp_wifi_connect())
 }
 
+TWifiTimings WifiTimings() {
+    return Timings;
+}
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string_view>
 #include <tcpip_adapter.h>
 
+#include "config_store.h"
+
 class INetworkCallback {
 public:
     virtual ~INetworkCallback() = default;
@@ -11,5 +14,22 @@ public:
     virtual void OnWifiConnected(const tcpip_adapter_ip_info_t& info) = 0;
 };
 
+// The phases of the last connection, microseconds since the boot, 0 when the phase is not reached
+struct TWifiTimings {
+    int64_t StartUs;
+    int64_t AssociatedUs;
+    int64_t GotIpUs;
+    // It was a directed association with the cached access point, without a scan
+    bool Directed;
+};
+
 void StartSoftAP();
-void ConnectWifi(std::string_view ssid, std::string_view password, INetworkCallback* callback);
+// The credentials and the cached access point come from the config. The access point is updated
+// there after every connection, so the next boot goes to it without a scan.
+void ConnectWifi(TConfigStore* config, INetworkCallback* callback);
+// Tries the access point again after a disconnection, the station itself doesn't
+void ReconnectWifi();
+// The radio of the station sleeps between the beacons. A command takes a few hundred milliseconds
+// longer to arrive then, so it only sleeps while the lights don't move.
+void SetWifiSleep(bool sleep);
+TWifiTimings WifiTimings();
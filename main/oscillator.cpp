@@ -0,0 +1,57 @@
+#include "oscillator.h"
+
+#include <array>
+
+namespace {
+    using TWaveTable = std::array<uint32_t, TOscillator::TableSize + 1>;
+
+    // Unipolar samples in Q16. The entries are 32-bit so the reads from flash stay word aligned.
+    template<typename TShape>
+    constexpr TWaveTable MakeTable(TShape shape) {
+        TWaveTable result{};
+        for (uint32_t i = 0; i <= TOscillator::TableSize; ++i) {
+            double value = shape(static_cast<double>(i) / TOscillator::TableSize);
+            result[i] = static_cast<uint32_t>(value * 65536 + 0.5);
+        }
+        return result;
+    }
+
+    constexpr double Triangle(double x) {
+        return x < .5 ? 2 * x : 2 - 2 * x;
+    }
+
+    // const tables are placed into .rodata, which the SDK keeps in flash
+    constexpr TWaveTable SineTable = MakeTable([](double x) {
+        return .5 + .5 * NFixed::ConstSin(2 * NFixed::Pi * x);
+    });
+
+    constexpr TWaveTable TriangleTable = MakeTable(Triangle);
+
+    // Smoothstep of the triangle: slow at the top and the bottom like breathing
+    constexpr TWaveTable EaseTable = MakeTable([](double x) {
+        double t = Triangle(x);
+        return t * t * (3 - 2 * t);
+    });
+
+    // The guard entry is 1, so the interpolation of the last step does not jump to 0
+    constexpr TWaveTable SawtoothTable = MakeTable([](double x) {
+        return x;
+    });
+}
+
+void TOscillator::SetWaveform(EWaveform waveform) {
+    switch (waveform) {
+        case EWaveform::Sine:
+            Table_ = SineTable.data();
+            break;
+        case EWaveform::Triangle:
+            Table_ = TriangleTable.data();
+            break;
+        case EWaveform::Ease:
+            Table_ = EaseTable.data();
+            break;
+        case EWaveform::Sawtooth:
+            Table_ = SawtoothTable.data();
+            break;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include "modes.h"
+
+enum class EWaveform {
+    Sine,
+    Triangle,
+    Ease,
+    Sawtooth,
+};
+
+// Direct digital synthesis: a 32-bit phase accumulator walks through a wavetable.
+// A full turn of the phase is one period, so the frequency is just the increment
+// and can be changed at any moment without a jump of the output.
+class TOscillator {
+public:
+    TOscillator(EWaveform waveform, uint32_t periodFrames) {
+        SetWaveform(waveform);
+        SetPeriod(periodFrames);
+    }
+
+    void SetWaveform(EWaveform waveform);
+
+    void SetPeriod(uint32_t frames) {
+        Increment_ = static_cast<uint32_t>((static_cast<uint64_t>(1) << 32) / (frames == 0 ? 1 : frames));
+    }
+
+    // Frequency in 1/1000 Hz for the given frame rate
+    void SetFrequency(uint32_t milliHertz, uint32_t frameRate) {
+        Increment_ = static_cast<uint32_t>((static_cast<uint64_t>(milliHertz) << 32) / (1000ull * frameRate));
+    }
+
+    void SetIncrement(uint32_t increment) {
+        Increment_ = increment;
+    }
+
+    [[nodiscard]] uint32_t GetIncrement() const {
+        return Increment_;
+    }
+
+    void SetPhase(uint32_t phase) {
+        Phase_ = phase;
+    }
+
+    [[nodiscard]] uint32_t GetPhase() const {
+        return Phase_;
+    }
+
+    // Returns the next sample in [0, 1]
+    TLevel Next() {
+        Phase_ += Increment_;
+        return Sample(Phase_);
+    }
+
+    // Advances by the given increment instead of the own one, for the owners that scale the speed
+    TLevel Next(uint32_t increment) {
+        Phase_ += increment;
+        return Sample(Phase_);
+    }
+
+    [[nodiscard]] TLevel Sample(uint32_t phase) const {
+        auto index = phase >> (32 - TableBits);
+        auto fraction = static_cast<int32_t>((phase >> (32 - TableBits - 16)) & 0xffff);
+        auto a = static_cast<int32_t>(Table_[index]);
+        auto b = static_cast<int32_t>(Table_[index + 1]);
+        int32_t value = a + (((b - a) * fraction) >> 16);
+#ifdef CONFIG_MODES_FIXED_POINT
+        return TFixed::FromRaw(value << (TFixed::FractionBits - 16));
+#else
+        return value * (1.0 / 65536);
+#endif
+    }
+
+    static constexpr int TableBits = 8;
+    static constexpr uint32_t TableSize = 1u << TableBits;
+
+private:
+    const uint32_t* Table_ = nullptr;
+    uint32_t Phase_ = 0;
+    uint32_t Increment_ = 0;
+};
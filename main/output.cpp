@@ -1,11 +1,17 @@
 #include "output.h"
 
-#include "modes.h"
+#include "cycles.h"
+#include "frame_scheduler.h"
+#include "registry.h"
 #include "hardware.h"
+#include "wakeups.h"
 
-#include <random>
-#include <vector>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
 #include <esp_system.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 #include <freertos/task.h>
@@ -16,83 +22,455 @@ extern "C" {
 #include <esp_task_wdt.h>
 }
 
+static constexpr uint32_t FrameRate = CONFIG_OUTPUT_FRAME_RATE;
+static constexpr uint32_t DutyScale = 1000;
+// Frames rendered per wake up of the OutputTask. Two blocks are queued,
+// so a command is visible at most 2 * BlockSize frames later.
+static constexpr size_t BlockSize = 4;
+static constexpr TickType_t ReportPeriod = 60000 / portTICK_PERIOD_MS;
+static constexpr uint32_t DefaultFadeMs = CONFIG_OUTPUT_FADE_MS;
+// The state is saved this long after the last change, so a burst of commands is one flash write
+static constexpr TickType_t SaveDelay = 5000 / portTICK_PERIOD_MS;
+
+// Duties of all channels for one frame
+using TFrame = std::array<uint32_t, OutputChannels>;
+
+// Single producer (OutputTask), single consumer (frame timer) queue of future frames
+class TFrameRing {
+public:
+    static constexpr size_t Size = 2 * BlockSize;
+    static_assert((Size & (Size - 1)) == 0);
+
+    [[nodiscard]] size_t Free() const {
+        return Size - (Write_.load() - Read_.load());
+    }
+
+    void Push(const TFrame* frames, size_t count) {
+        auto write = Write_.load();
+        for (size_t i = 0; i < count; ++i) {
+            Buffer_[(write + i) & (Size - 1)] = frames[i];
+        }
+        Write_.store(write + count);
+    }
+
+    bool Pop(TFrame& frame) {
+        auto read = Read_.load();
+        if (read == Write_.load()) {
+            return false;
+        }
+        frame = Buffer_[read & (Size - 1)];
+        Read_.store(read + 1);
+        return true;
+    }
+
+private:
+    std::array<TFrame, Size> Buffer_{};
+    std::atomic<uint32_t> Write_{0};
+    std::atomic<uint32_t> Read_{0};
+};
+
+// Blocks of the same frame rendered before the frames stop. Then the ring holds nothing else
+// and the PWM already shows it.
+static constexpr uint32_t SettleBlocks = TFrameRing::Size / BlockSize + 1;
+
+// Linear Q15 ramp between 0 and One, moved by one step per frame
+struct TRamp {
+    static constexpr uint32_t One = 1 << 15;
+
+    uint32_t Value = 0;
+
+    void Up(uint32_t step) {
+        Value = Value + step < One ? Value + step : One;
+    }
+
+    void Down(uint32_t step) {
+        Value = Value > step ? Value - step : 0;
+    }
+};
+
+static constexpr uint32_t FadeStep(uint32_t fadeMs) {
+    auto frames = fadeMs * FrameRate / 1000;
+    return frames == 0 ? TRamp::One : (TRamp::One + frames - 1) / frames;
+}
+
+// Every strand runs its own instances of the modes with its own random sequence
+struct TChannel {
+    TModeSet Modes;
+    std::array<TModeParams, ModeCount> Params;
+    bool IsOn = false;
+    uint32_t Current = 0;
+    // The outgoing mode while Crossfade is below One, it is blended with the current one
+    uint32_t Previous = 0;
+    TRamp Crossfade{TRamp::One};
+    // Attack and release of on and off
+    TRamp Envelope;
+    uint16_t Fade = DefaultFadeMs;
+    uint32_t Step = FadeStep(DefaultFadeMs);
+    uint8_t Brightness = 100;
+    // Full duty at the brightness of the channel. The duty is the square of the level,
+    // so the brightness is squared as well to dim evenly.
+    uint32_t Scale = DutyScale;
+};
+
 static QueueHandle_t ControlQueue;
+static TaskHandle_t RenderTask;
+static TFrameRing Ring;
+static std::atomic<uint32_t> Underruns{0};
+static std::atomic<uint32_t> FirstLightUs{0};
+static std::array<TChannel, OutputChannels> Channels;
+
+// The PWM driver owns FRC1, the only hardware timer the application can use on ESP8266,
+// so the frames are clocked by esp_timer. It only moves one frame to the PWM per tick
+// and reloads the PWM once, only when some duty has changed. The frames of the missed
+// deadlines are dropped, so the output stays in time.
+static void FrameTimerCallback(void*, uint32_t skipped) {
+    NWakeups::Count(EWakeSource::Frame);
+    static TFrame lastFrame{};
+    TFrame frame;
+    bool ready = false;
+    for (uint32_t i = 0; i <= skipped; ++i) {
+        ready = Ring.Pop(frame);
+        if (!ready) {
+            Underruns += skipped + 1 - i;
+            break;
+        }
+    }
+    if (ready) {
+        bool changed = false;
+        for (size_t i = 0; i < OutputChannels; ++i) {
+            if (frame[i] != lastFrame[i]) {
+                pwm_set_duty(i, frame[i]);
+                changed = true;
+            }
+        }
+        if (changed) {
+            lastFrame = frame;
+            pwm_start();
+            if (FirstLightUs.load() == 0) {
+                for (auto duty : frame) {
+                    if (duty != 0) {
+                        FirstLightUs = static_cast<uint32_t>(esp_timer_get_time());
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    if (Ring.Free() >= BlockSize) {
+        xTaskNotifyGive(RenderTask);
+    }
+}
+
+static TFrameScheduler Scheduler(FrameRate, FrameTimerCallback, nullptr);
+
+static void SwitchMode(TChannel& channel, uint32_t mode) {
+    if (mode == channel.Current) {
+        return;
+    }
+    bool crossfading = channel.Crossfade.Value < TRamp::One;
+    if (crossfading && mode == channel.Previous) {
+        // Going back turns the crossfade around without a jump
+        channel.Previous = channel.Current;
+        channel.Current = mode;
+        channel.Crossfade.Value = TRamp::One - channel.Crossfade.Value;
+        return;
+    }
+    // A third mode in the middle of a crossfade replaces the less visible one
+    if (!crossfading || channel.Crossfade.Value >= TRamp::One / 2) {
+        channel.Previous = channel.Current;
+    }
+    channel.Current = mode;
+    channel.Crossfade.Value = channel.Envelope.Value == 0 ? TRamp::One : 0;
+}
+
+static void SetFade(TChannel& channel, uint16_t fade) {
+    channel.Fade = fade;
+    channel.Step = FadeStep(fade);
+}
+
+static void SetBrightness(TChannel& channel, uint8_t brightness) {
+    channel.Brightness = brightness;
+    channel.Scale = DutyScale * brightness * brightness / 10000;
+}
+
+static void ApplyCommand(TChannel& channel, size_t index, const TCommand& cmd, IOutputCallback* callback) {
+    if (cmd.Fade) {
+        SetFade(channel, *cmd.Fade);
+    }
+    if (cmd.Brightness) {
+        SetBrightness(channel, *cmd.Brightness);
+    }
+    switch (cmd.State) {
+        case EOutputState::Off:
+            channel.IsOn = false;
+            break;
+        case EOutputState::On:
+            channel.IsOn = true;
+            break;
+        case EOutputState::Toggle:
+            channel.IsOn = !channel.IsOn;
+            break;
+        case EOutputState::Next:
+            if (!channel.IsOn) {
+                channel.IsOn = true;
+            } else {
+                SwitchMode(channel, channel.Current == channel.Modes.size() - 1 ? 0 : channel.Current + 1);
+            }
+            break;
+        case EOutputState::NextOn:
+            SwitchMode(channel, channel.Current == channel.Modes.size() - 1 ? 0 : channel.Current + 1);
+            channel.IsOn = true;
+            break;
+        case EOutputState::Mode:
+            if (cmd.Mode >= ModeCount) {
+                return;
+            }
+            SwitchMode(channel, cmd.Mode);
+            channel.IsOn = true;
+            break;
+        case EOutputState::Unknown:
+            break;
+    }
+    // Speed and intensity are for the mode the command ends in
+    if (cmd.Speed || cmd.Intensity) {
+        auto& params = channel.Params[channel.Current];
+        params.Speed = LimitSpeed(channel.Current, cmd.Speed.value_or(params.Speed));
+        params.Intensity = cmd.Intensity.value_or(params.Intensity);
+        std::visit([&](auto& mode) { mode.configure(params); }, channel.Modes[channel.Current]);
+    }
+    if (cmd.State != EOutputState::Unknown) {
+        callback->OnOutputChanged(index, channel.IsOn, channel.Current);
+    }
+}
+
+static void RenderMode(TChannel& channel, uint32_t mode, TLevel* levels, TOutputReport& report) {
+    auto start = NCycles::Now();
+    std::visit([&](auto& slot) { slot.render(levels, BlockSize); }, channel.Modes[mode]);
+    report.StepCost[mode].Add((NCycles::Now() - start) / BlockSize);
+}
+
+// Blends in the duty domain with integer math. The envelope is squared like the levels,
+// so on and off fade evenly to the eye.
+static void RenderChannel(TChannel& channel, size_t index, std::array<TFrame, BlockSize>& frames, TOutputReport& report) {
+    if (!channel.IsOn && channel.Envelope.Value == 0) {
+        for (auto& frame : frames) {
+            frame[index] = 0;
+        }
+        return;
+    }
+    std::array<TLevel, BlockSize> levels;
+    std::array<TLevel, BlockSize> previous;
+    RenderMode(channel, channel.Current, levels.data(), report);
+    bool crossfading = channel.Crossfade.Value < TRamp::One;
+    if (crossfading) {
+        RenderMode(channel, channel.Previous, previous.data(), report);
+    }
+    for (size_t i = 0; i < BlockSize; ++i) {
+        auto duty = LevelToDuty(levels[i], channel.Scale);
+        if (crossfading) {
+            auto weight = channel.Crossfade.Value;
+            duty = (LevelToDuty(previous[i], channel.Scale) * (TRamp::One - weight) + duty * weight) >> 15;
+            channel.Crossfade.Up(channel.Step);
+        }
+        if (channel.IsOn) {
+            channel.Envelope.Up(channel.Step);
+        } else {
+            channel.Envelope.Down(channel.Step);
+        }
+        auto envelope = channel.Envelope.Value * channel.Envelope.Value >> 15;
+        frames[i][index] = duty * envelope >> 15;
+    }
+}
+
+// The channel renders the same frame over and over: it is off and dark, or it shows
+// a constant mode at the full envelope
+static bool IsSteady(const TChannel& channel) {
+    if (!channel.IsOn) {
+        return channel.Envelope.Value == 0;
+    }
+    return channel.Envelope.Value == TRamp::One && channel.Crossfade.Value == TRamp::One
+        && std::visit([](const auto& mode) { return mode.constant(); }, channel.Modes[channel.Current]);
+}
+
+static bool AllSteady() {
+    return std::all_of(Channels.begin(), Channels.end(), IsSteady);
+}
+
+// An idle task only waits for the save and the report
+static TickType_t IdleWait(bool dirty, TickType_t changedAt, TickType_t reportedAt) {
+    auto now = xTaskGetTickCount();
+    auto wait = now - reportedAt < ReportPeriod ? ReportPeriod - (now - reportedAt) : 0;
+    if (dirty) {
+        wait = std::min<TickType_t>(wait, now - changedAt < SaveDelay ? SaveDelay - (now - changedAt) : 0);
+    }
+    return wait;
+}
+
+static TOutputSnapshot TakeSnapshot() {
+    TOutputSnapshot snapshot{};
+    for (size_t i = 0; i < OutputChannels; ++i) {
+        auto& channel = Channels[i];
+        snapshot[i].IsOn = channel.IsOn;
+        snapshot[i].Mode = static_cast<uint8_t>(channel.Current);
+        snapshot[i].Brightness = channel.Brightness;
+        snapshot[i].Fade = channel.Fade;
+        snapshot[i].Params = channel.Params;
+    }
+    return snapshot;
+}
+
+static void RestoreSnapshot(const TOutputSnapshot& snapshot) {
+    for (size_t i = 0; i < OutputChannels; ++i) {
+        auto& channel = Channels[i];
+        channel.IsOn = snapshot[i].IsOn;
+        channel.Current = snapshot[i].Mode < ModeCount ? snapshot[i].Mode : 0;
+        channel.Previous = channel.Current;
+        SetBrightness(channel, std::min<uint8_t>(snapshot[i].Brightness, 100));
+        SetFade(channel, std::min(snapshot[i].Fade, MaxFadeMs));
+        for (size_t mode = 0; mode < ModeCount; ++mode) {
+            auto& params = channel.Params[mode];
+            params.Speed = LimitSpeed(mode, std::clamp(snapshot[i].Params[mode].Speed, MinSpeed, MaxSpeed));
+            params.Intensity = std::min(snapshot[i].Params[mode].Intensity, MaxIntensity);
+        }
+    }
+}
 
 [[noreturn]] void OutputTask(void *arg) noexcept {
     auto callback = static_cast<IOutputCallback *>(arg);
-    std::mt19937 generator(esp_random());
-    std::vector<std::shared_ptr<IMode>> modes;
-    modes.emplace_back(CreateStatic());
-    modes.emplace_back(CreateDynamic(1000));
-    modes.emplace_back(CreateFireplace());
-    modes.emplace_back(CreateCandle());
-    bool isOn = false;
-    uint32_t current = 0;
+    for (auto& channel : Channels) {
+        CreateModes(channel.Modes);
+        for (size_t i = 0; i < ModeCount; ++i) {
+            std::visit([&](auto& slot) {
+                slot.seed(esp_random());
+                slot.configure(channel.Params[i]);
+            }, channel.Modes[i]);
+        }
+    }
+    std::array<TFrame, BlockSize> frames;
+    TOutputReport report{};
+    bool dirty = false;
+    TickType_t changedAt = 0;
+    TickType_t reportedAt = xTaskGetTickCount();
+    // Without the frames nothing wakes the task but the commands
+    bool idle = false;
+    TickType_t idleSince = 0;
+    TickType_t idleTicks = 0;
+    uint32_t steadyBlocks = 0;
 
     while(true) {
         esp_task_wdt_reset();
-        EOutputState cmd;
-        TickType_t lastWakeTime;
-        if (xQueueReceive(ControlQueue, &cmd, 5)) {
-            switch (cmd) {
-                case EOutputState::Off:
-                    isOn = false;
-                    callback->OnOutputChanged(isOn, current);
-                    break;
-                case EOutputState::On:
-                    isOn = true;
-                    callback->OnOutputChanged(isOn, current);
-                    break;
-                case EOutputState::Toggle:
-                    isOn = !isOn;
-                    callback->OnOutputChanged(isOn, current);
-                    break;
-                case EOutputState::Next:
-                    if (!isOn) {
-                        isOn = true;
-                    } else {
-                        current = current == modes.size() - 1 ? 0 : current + 1;
-                    }
-                    callback->OnOutputChanged(isOn, current);
-                    break;
-                case EOutputState::Static:
-                case EOutputState::Dynamic:
-                case EOutputState::Fireplace:
-                case EOutputState::Candle: {
-                    current = static_cast<uint32_t>(cmd) - static_cast<uint32_t>(EOutputState::Static);
-                    isOn = true;
-                    callback->OnOutputChanged(isOn, current);
-                    break;
+        // Commands only wake the task to render ahead, the frames keep the pace of the scheduler
+        ulTaskNotifyTake(pdTRUE, idle ? IdleWait(dirty, changedAt, reportedAt) : BlockSize * 1000 / FrameRate / portTICK_PERIOD_MS);
+        NWakeups::Count(EWakeSource::Output);
+        bool changed = false;
+        TCommand cmd;
+        while (xQueueReceive(ControlQueue, &cmd, 0)) {
+            for (size_t i = 0; i < OutputChannels; ++i) {
+                if (cmd.Channel == AllChannels || cmd.Channel == i) {
+                    ApplyCommand(Channels[i], i, cmd, callback);
                 }
-                case EOutputState::Unknown:
-                    break;
             }
+            changed = true;
+            dirty = true;
+            changedAt = xTaskGetTickCount();
+        }
+        if (changed) {
+            steadyBlocks = 0;
+            if (idle) {
+                idle = false;
+                idleTicks += xTaskGetTickCount() - idleSince;
+                Scheduler.Start();
+                callback->OnOutputIdle(false);
+            }
+        }
+        while (!idle && Ring.Free() >= BlockSize) {
+            bool steady = AllSteady();
+            auto blockStart = NCycles::Now();
+            for (size_t c = 0; c < OutputChannels; ++c) {
+                RenderChannel(Channels[c], c, frames, report);
+            }
+            Ring.Push(frames.data(), frames.size());
+            auto frameCost = (NCycles::Now() - blockStart) / BlockSize;
+            if (frameCost > report.WorstFrame) {
+                report.WorstFrame = frameCost;
+            }
+            report.PeriodFrames += BlockSize;
+            steadyBlocks = steady ? steadyBlocks + 1 : 0;
+        }
+        // The frames that are left in the ring are the same as the shown one, they play after the start
+        if (!idle && steadyBlocks >= SettleBlocks) {
+            idle = true;
+            idleSince = xTaskGetTickCount();
+            Scheduler.Stop();
+            callback->OnOutputIdle(true);
+        }
+        // The state goes out right after the rendering, with the ring full
+        if (dirty && xTaskGetTickCount() - changedAt >= SaveDelay) {
+            dirty = false;
+            callback->OnOutputSave(TakeSnapshot());
         }
-        vTaskDelayUntil(&lastWakeTime, 10);
-        auto value = isOn ? modes[current]->step(generator) : 0.0;
-        //ESP_LOGI("VAL", "Value: %ld", static_cast<long>(value * 10000));
-        if (value > 1.0) {
-            value = 1.0;
-        } else if (value < 0.0) {
-            value = 0.0;
+        auto now = xTaskGetTickCount();
+        if (now - reportedAt >= ReportPeriod) {
+            if (idle) {
+                idleTicks += now - idleSince;
+                idleSince = now;
+            }
+            report.PeriodMs = (now - reportedAt) * portTICK_PERIOD_MS;
+            report.IdleMs = idleTicks * portTICK_PERIOD_MS;
+            report.Wakeups = NWakeups::Take();
+            report.Totals = OutputGetStats();
+            report.Jitter = Scheduler.TakeJitter();
+            callback->OnOutputReport(report);
+            report = {};
+            reportedAt = now;
+            idleTicks = 0;
         }
-        pwm_set_duty(0, static_cast<uint32_t>(value * value * 1000));
-        pwm_start();
     }
 }
 
-void OutputSet(EOutputState command) {
+void OutputSet(const TCommand& command) {
     xQueueSend(ControlQueue, &command, 5);
+    xTaskNotifyGive(RenderTask);
+}
+
+void OutputSet(EOutputState command, uint8_t channel) {
+    TCommand cmd;
+    cmd.State = command;
+    cmd.Channel = channel;
+    OutputSet(cmd);
 }
 
-void OutputInit(IOutputCallback* callback) {
-    uint32_t pwm_nums = Output;
-    uint32_t duties = 0;
+void OutputInit(IOutputCallback* callback, const TOutputSnapshot* restore) {
+    static_assert(OutputChannels >= 1 && OutputChannels <= Outputs.size());
+#ifndef CONFIG_OUTPUT_STRAPPING_PINS
+    static_assert(OutputChannels <= 4, "Strands 5 and 6 are on the boot strapping pins, see OUTPUT_STRAPPING_PINS");
+#endif
+    std::array<uint32_t, OutputChannels> pins;
+    std::array<uint32_t, OutputChannels> duties{};
+    std::array<float, OutputChannels> phases;
+    // Staggered phases spread the switching edges of the strands over the PWM period
+    for (size_t i = 0; i < OutputChannels; ++i) {
+        pins[i] = Outputs[i];
+        phases[i] = 360.f * i / OutputChannels;
+        if (phases[i] >= 180.f) {
+            phases[i] -= 360.f;
+        }
+    }
 
-    pwm_init(1000, &duties, 1, &pwm_nums);
-    pwm_set_phase(0, 0);
+    pwm_init(DutyScale, duties.data(), OutputChannels, pins.data());
+    pwm_set_phases(phases.data());
     pwm_start();
 
-    ControlQueue = xQueueCreate(6, sizeof(EOutputState));
-    xTaskCreate(OutputTask, "OutputTask", 4096, callback, 5, nullptr);
+    static_assert(std::is_trivially_copyable_v<TCommand>);
+    if (restore != nullptr) {
+        RestoreSnapshot(*restore);
+    }
+    ControlQueue = xQueueCreate(6, sizeof(TCommand));
+    xTaskCreate(OutputTask, "OutputTask", 4096, callback, 5, &RenderTask);
+
+    Scheduler.Start();
+}
+
+TOutputStats OutputGetStats() {
+    return {Scheduler.Frames(), Scheduler.MissedDeadlines(), Underruns.load(), FirstLightUs.load()};
 }
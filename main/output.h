@@ -1,6 +1,23 @@
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <sdkconfig.h>
+
+#include "frame_scheduler.h"
+#include "histogram.h"
+#include "registry.h"
+#include "wakeups.h"
+
+static constexpr size_t OutputChannels = CONFIG_OUTPUT_CHANNELS;
+static constexpr uint8_t AllChannels = 0xff;
+// The ranges of the commands, a restored state is held to them as well
+static constexpr uint16_t MinSpeed = 10;
+static constexpr uint16_t MaxSpeed = 1000;
+static constexpr uint8_t MaxIntensity = 100;
+static constexpr uint16_t MaxFadeMs = 60000;
 
 enum class EOutputState {
     Unknown,
@@ -8,17 +25,81 @@ enum class EOutputState {
     Off,
     Toggle,
     Next,
-    Static,
-    Dynamic,
-    Fireplace,
-    Candle
+    // Next mode also when it is off, it turns on in it. The double click comes after the click
+    // that has toggled, so it doesn't depend on that state.
+    NextOn,
+    // Switches to TCommand::Mode, the index of the mode in the registry
+    Mode,
+};
+
+// One control message. The optional fields are applied together with the state,
+// so a whole scene change is one queue round trip.
+struct TCommand {
+    EOutputState State = EOutputState::Unknown;
+    uint8_t Channel = AllChannels;
+    uint8_t Mode = 0;
+    // Percent of the full brightness
+    std::optional<uint8_t> Brightness;
+    // Animation speed and depth of the current mode in percent of the normal ones
+    std::optional<uint16_t> Speed;
+    std::optional<uint8_t> Intensity;
+    // Transition time in milliseconds, kept by the channel for the following transitions
+    std::optional<uint16_t> Fade;
+};
+
+struct TOutputStats {
+    uint32_t Frames;
+    // Frames the timer came too late for, they are skipped to keep the animation speed
+    uint32_t MissedDeadlines;
+    // Frames the OutputTask has not rendered in time, the previous duties are held
+    uint32_t Underruns;
+    // Time from the boot to the first frame with light, 0 until then
+    uint32_t FirstLightUs;
+};
+
+// The part of the state of a channel that survives a power cut
+struct TChannelState {
+    bool IsOn;
+    uint8_t Mode;
+    uint8_t Brightness;
+    uint16_t Fade;
+    std::array<TModeParams, ModeCount> Params;
+};
+
+using TOutputSnapshot = std::array<TChannelState, OutputChannels>;
+
+// Cost of one step of a mode in CPU cycles, buckets from 256 cycles to 16K
+using TCostHistogram = THistogram<8>;
+
+// Summary of the output over the last report period
+struct TOutputReport {
+    uint32_t PeriodMs;
+    // Part of the period the frames were stopped, the output was off or static
+    uint32_t IdleMs;
+    TWakeCounts Wakeups;
+    uint32_t PeriodFrames;
+    TOutputStats Totals;
+    TJitterHistogram Jitter;
+    // Worst cost of rendering one frame of all channels in CPU cycles
+    uint32_t WorstFrame;
+    std::array<TCostHistogram, ModeCount> StepCost;
 };
 
 class IOutputCallback {
 public:
     virtual ~IOutputCallback() = default;
-    virtual void OnOutputChanged(bool isOn, size_t mode) = 0;
+    virtual void OnOutputChanged(size_t channel, bool isOn, size_t mode) = 0;
+    // Called from the OutputTask every report period. It must not block, like OnOutputSave().
+    virtual void OnOutputReport(const TOutputReport& report) = 0;
+    // Called from the OutputTask a few seconds after the last change of the state. It must not
+    // block, the frame ring lasts only a few frames.
+    virtual void OnOutputSave(const TOutputSnapshot& snapshot) = 0;
+    // Called from the OutputTask when the frames stop, because nothing moves, and when they start again
+    virtual void OnOutputIdle(bool idle) = 0;
 };
 
-void OutputSet(EOutputState command);
-void OutputInit(IOutputCallback* callback);
\ No newline at end of file
+void OutputSet(const TCommand& command);
+void OutputSet(EOutputState command, uint8_t channel = AllChannels);
+// The channels start from the restored state, if there is one
+void OutputInit(IOutputCallback* callback, const TOutputSnapshot* restore = nullptr);
+TOutputStats OutputGetStats();
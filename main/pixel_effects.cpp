@@ -0,0 +1,124 @@
+#include "pixels.h"
+#include "registry.h"
+
+#include <utility>
+#include <vector>
+
+namespace {
+    struct TPalette {
+        uint8_t R;
+        uint8_t G;
+        uint8_t B;
+    };
+
+    constexpr TPalette WarmWhite{255, 180, 90};
+    constexpr TPalette Flame{255, 100, 12};
+    constexpr TPalette Wax{255, 130, 30};
+
+    TPixel Shade(TLevel level, const TPalette& palette) {
+        auto value = LevelToDuty(level, 256);
+        return {
+            static_cast<uint8_t>((value * palette.R) >> 8),
+            static_cast<uint8_t>((value * palette.G) >> 8),
+            static_cast<uint8_t>((value * palette.B) >> 8),
+        };
+    }
+
+    // One effect instance per pixel, so every pixel flickers on its own.
+    // They share the generator, each pixel still draws its own samples from it.
+    template<typename TEffect>
+    class TPixelNoise : public IPixelEffect {
+    public:
+        TPixelNoise(size_t count, const TPalette& palette)
+            : Pixels_(count), Params_(TEffect{}.configure({})), Palette_(palette) {
+        }
+
+        void render(TPixel* frame, size_t count) override {
+            for (size_t i = 0; i < count && i < Pixels_.size(); ++i) {
+                frame[i] = Shade(Pixels_[i].next(Params_, Generator_), Palette_);
+            }
+        }
+
+        void seed(uint32_t seed) override {
+            Generator_.Seed(seed);
+        }
+
+    private:
+        std::vector<TEffect> Pixels_;
+        typename TEffect::TParams Params_;
+        TPalette Palette_;
+        TRandom Generator_;
+    };
+
+    class TPixelStatic : public IPixelEffect {
+    public:
+        void render(TPixel* frame, size_t count) override {
+            auto pixel = Shade(TLevel(1.0), WarmWhite);
+            for (size_t i = 0; i < count; ++i) {
+                frame[i] = pixel;
+            }
+        }
+
+        void seed(uint32_t) override {
+        }
+    };
+
+    // The breathing of the Dynamic mode runs along the strip as a wave, one oscillator for all pixels
+    class TPixelDynamic : public IPixelEffect {
+    public:
+        explicit TPixelDynamic(size_t count)
+            : Oscillator_(EWaveform::Sine, 1000)
+            , Spread_(static_cast<uint32_t>(0xffffffffu / (count == 0 ? 1 : count))) {
+        }
+
+        void render(TPixel* frame, size_t count) override {
+            Oscillator_.Next();
+            uint32_t phase = Oscillator_.GetPhase();
+            for (size_t i = 0; i < count; ++i) {
+                frame[i] = Shade(Oscillator_.Sample(phase), WarmWhite);
+                phase += Spread_;
+            }
+        }
+
+        void seed(uint32_t) override {
+        }
+
+    private:
+        TOscillator Oscillator_;
+        uint32_t Spread_;
+    };
+}
+
+namespace {
+    // The strip shows a mode with the effect of the same type, a mode without one is static
+    template<typename TEffect>
+    std::unique_ptr<IPixelEffect> CreateFor(size_t) {
+        return std::make_unique<TPixelStatic>();
+    }
+
+    template<>
+    std::unique_ptr<IPixelEffect> CreateFor<Dynamic>(size_t count) {
+        return std::make_unique<TPixelDynamic>(count);
+    }
+
+    template<>
+    std::unique_ptr<IPixelEffect> CreateFor<Fireplace>(size_t count) {
+        return std::make_unique<TPixelNoise<Fireplace>>(count, Flame);
+    }
+
+    template<>
+    std::unique_ptr<IPixelEffect> CreateFor<Candle>(size_t count) {
+        return std::make_unique<TPixelNoise<Candle>>(count, Wax);
+    }
+
+    template<size_t... Index>
+    std::unique_ptr<IPixelEffect> Create(size_t mode, size_t count, std::index_sequence<Index...>) {
+        std::unique_ptr<IPixelEffect> result;
+        ((mode == Index ? (result = CreateFor<TModeEffect<Index>>(count), true) : false) || ...);
+        return result ? std::move(result) : std::make_unique<TPixelStatic>();
+    }
+}
+
+std::unique_ptr<IPixelEffect> CreatePixelEffect(size_t mode, size_t count) {
+    return Create(mode, count, std::make_index_sequence<ModeCount>());
+}
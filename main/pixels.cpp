@@ -0,0 +1,65 @@
+#include "pixels.h"
+
+#include <vector>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+
+extern "C" {
+#include <esp_task_wdt.h>
+}
+
+static constexpr TickType_t PixelFramePeriod = 10 / portTICK_PERIOD_MS;
+
+struct TPixelCommand {
+    bool IsOn;
+    uint8_t Mode;
+};
+
+static QueueHandle_t PixelQueue;
+static IPixelSink* Sink;
+static size_t PixelCount;
+
+[[noreturn]] void PixelTask(void*) noexcept {
+    std::vector<TPixel> frame(PixelCount);
+    std::unique_ptr<IPixelEffect> effect;
+    bool isOn = false;
+    size_t mode = 0;
+    TickType_t lastWakeTime = xTaskGetTickCount();
+
+    while (true) {
+        esp_task_wdt_reset();
+        TPixelCommand cmd;
+        while (xQueueReceive(PixelQueue, &cmd, 0)) {
+            isOn = cmd.IsOn;
+            if (isOn && (!effect || mode != cmd.Mode)) {
+                // Free the old effect first, the per pixel state of two effects may not fit together
+                effect.reset();
+                effect = CreatePixelEffect(cmd.Mode, PixelCount);
+                effect->seed(esp_random());
+                mode = cmd.Mode;
+            }
+        }
+        if (isOn) {
+            effect->render(frame.data(), frame.size());
+        } else {
+            std::fill(frame.begin(), frame.end(), TPixel{0, 0, 0});
+        }
+        Sink->Show(frame.data(), frame.size());
+        vTaskDelayUntil(&lastWakeTime, PixelFramePeriod);
+    }
+}
+
+void PixelSet(bool isOn, size_t mode) {
+    TPixelCommand cmd{isOn, static_cast<uint8_t>(mode)};
+    xQueueSend(PixelQueue, &cmd, 5);
+}
+
+void PixelInit(IPixelSink* sink, size_t count) {
+    Sink = sink;
+    PixelCount = count;
+    PixelQueue = xQueueCreate(4, sizeof(TPixelCommand));
+    xTaskCreate(PixelTask, "PixelTask", 2048, nullptr, 5, nullptr);
+}
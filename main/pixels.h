@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+struct TPixel {
+    uint8_t R;
+    uint8_t G;
+    uint8_t B;
+};
+
+// Renders whole frames of an addressable strip
+class IPixelEffect {
+public:
+    virtual ~IPixelEffect() = default;
+    virtual void render(TPixel* frame, size_t count) = 0;
+    virtual void seed(uint32_t seed) = 0;
+};
+
+// Receives the finished frames: the WS2812 serializer on the device, a capture on the host
+class IPixelSink {
+public:
+    virtual ~IPixelSink() = default;
+    virtual void Show(const TPixel* frame, size_t count) = 0;
+};
+
+// mode is the index of the mode in the registry, like for the PWM outputs
+std::unique_ptr<IPixelEffect> CreatePixelEffect(size_t mode, size_t count);
+
+void PixelSet(bool isOn, size_t mode);
+void PixelInit(IPixelSink* sink, size_t count);
@@ -0,0 +1,38 @@
+#include "random.h"
+#include "fixed.h"
+
+namespace {
+    // Acklam's rational approximation of the normal quantile, relative error 1.15e-9
+    constexpr double Quantile(double p) {
+        constexpr double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+        constexpr double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                6.680131188771972e+01, -1.328068155288572e+01};
+        constexpr double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+        constexpr double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                3.754408661907416e+00};
+        constexpr double high = 1 - 0.02425;
+        if (p <= high) {
+            double q = p - 0.5;
+            double r = q * q;
+            return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q
+                   / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+        }
+        double q = NFixed::ConstSqrt(-2 * NFixed::ConstLog(1 - p));
+        return -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5])
+               / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    }
+
+    constexpr std::array<int32_t, (1 << NRandom::NormalBits) + 1> MakeNormalQuantiles() {
+        constexpr int size = 1 << NRandom::NormalBits;
+        std::array<int32_t, size + 1> result{};
+        for (int i = 0; i < size; ++i) {
+            result[i] = static_cast<int32_t>(Quantile(0.5 + 0.5 * i / size) * 65536 + 0.5);
+        }
+        result[size] = static_cast<int32_t>(Quantile(1 - 1. / 4096) * 65536 + 0.5);
+        return result;
+    }
+}
+
+constexpr std::array<int32_t, (1 << NRandom::NormalBits) + 1> NRandom::NormalQuantiles = MakeNormalQuantiles();
@@ -0,0 +1,173 @@
+#pragma once
+#include "effects.h"
+#include "modes.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace NRegistry {
+    template<typename TEffect, typename = void>
+    struct TIsConstant : std::false_type {
+    };
+
+    template<typename TEffect>
+    struct TIsConstant<TEffect, std::void_t<decltype(TEffect::Constant)>> : std::bool_constant<TEffect::Constant> {
+    };
+}
+
+// The speeds an effect follows, most take any speed of the commands
+struct TSpeedRange {
+    uint16_t Min;
+    uint16_t Max;
+};
+
+namespace NRegistry {
+    template<typename TEffect, typename = void>
+    struct TEffectSpeedRange {
+        static constexpr TSpeedRange Value{0, UINT16_MAX};
+    };
+
+    template<typename TEffect>
+    struct TEffectSpeedRange<TEffect, std::void_t<decltype(TEffect::MinSpeed), decltype(TEffect::MaxSpeed)>> {
+        static constexpr TSpeedRange Value{TEffect::MinSpeed, TEffect::MaxSpeed};
+    };
+}
+
+// Runs an effect with its own generator and parameters. There are no virtual calls,
+// render() is a tight loop the compiler can inline.
+template<typename TEffect>
+class TMode {
+public:
+    using TEffectType = TEffect;
+
+    explicit TMode(TEffect effect) : Effect_(std::move(effect)), Params_(Effect_.configure({})) {
+    }
+
+    // Only to default construct the variant, CreateModes() replaces it
+    template<typename T = TEffect, typename = std::enable_if_t<std::is_default_constructible_v<T>>>
+    TMode() : TMode(T{}) {
+    }
+
+    TLevel step() {
+        return Effect_.next(Params_, Generator_);
+    }
+
+    // Fills the next count frames in one call
+    void render(TLevel* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = Effect_.next(Params_, Generator_);
+        }
+    }
+
+    // The effect gives the same level every frame, whatever the parameters
+    static constexpr bool constant() {
+        return NRegistry::TIsConstant<TEffect>::value;
+    }
+
+    // The same seed gives the same sequence
+    void seed(uint32_t seed) {
+        Generator_.Seed(seed);
+    }
+
+    // Changes the speed and the intensity without a reset of the state, so the output does not jump
+    void configure(const TModeParams& params) {
+        Params_ = Effect_.configure(params);
+    }
+
+private:
+    TEffect Effect_;
+    typename TEffect::TParams Params_;
+    TRandom Generator_;
+};
+
+// What the rest of the firmware knows about a mode: the word of the control messages,
+// the word of the state topic and the blink pattern of the status LED, MSB first.
+struct TModeInfo {
+    std::string_view Name;
+    std::string_view State;
+    uint16_t LedPattern;
+};
+
+template<typename TEffect>
+struct TModeDefinition {
+    using TEffectType = TEffect;
+
+    TModeInfo Info;
+    TEffect (*Create)();
+};
+
+// Every mode is defined here and only here. The order is the mode number of the state,
+// the button cycles through them in it.
+inline constexpr auto ModeTable = std::make_tuple(
+    TModeDefinition<Static>{{"static", "on", 0x8000}, [] { return Static{}; }},
+    TModeDefinition<Dynamic>{{"dynamic", "dynamic", 0xb800}, [] { return Dynamic(1000, EWaveform::Sine); }},
+    TModeDefinition<Fireplace>{{"fireplace", "fireplace", 0xbb80}, [] { return Fireplace{}; }},
+    TModeDefinition<Candle>{{"candle", "candle", 0xbbb8}, [] { return Candle{}; }}
+);
+
+using TModeTable = std::remove_const_t<decltype(ModeTable)>;
+
+inline constexpr size_t ModeCount = std::tuple_size_v<TModeTable>;
+
+template<size_t Index>
+using TModeEffect = typename std::tuple_element_t<Index, TModeTable>::TEffectType;
+
+namespace NRegistry {
+    template<typename TTable>
+    struct TVariant;
+
+    template<typename... TEffects>
+    struct TVariant<std::tuple<TModeDefinition<TEffects>...>> {
+        using Type = std::variant<TMode<TEffects>...>;
+    };
+
+    template<size_t... Index>
+    constexpr std::array<TModeInfo, ModeCount> Infos(std::index_sequence<Index...>) {
+        return {std::get<Index>(ModeTable).Info...};
+    }
+
+    template<size_t... Index>
+    constexpr std::array<TSpeedRange, ModeCount> SpeedRanges(std::index_sequence<Index...>) {
+        return {TEffectSpeedRange<TModeEffect<Index>>::Value...};
+    }
+
+    template<size_t... Index>
+    void Create(std::array<typename TVariant<TModeTable>::Type, ModeCount>& modes, std::index_sequence<Index...>) {
+        (modes[Index].template emplace<Index>(std::get<Index>(ModeTable).Create()), ...);
+    }
+}
+
+// One mode of any kind in static storage, the alternative Index is the mode number Index
+using TModeVariant = NRegistry::TVariant<TModeTable>::Type;
+using TModeSet = std::array<TModeVariant, ModeCount>;
+
+inline constexpr std::array<TModeInfo, ModeCount> ModeInfos = NRegistry::Infos(std::make_index_sequence<ModeCount>());
+
+inline constexpr std::array<TSpeedRange, ModeCount> ModeSpeedRanges = NRegistry::SpeedRanges(std::make_index_sequence<ModeCount>());
+
+// The speed a mode runs at, so the stored and published speed is the one in effect
+inline uint16_t LimitSpeed(size_t mode, uint16_t speed) {
+    return std::clamp(speed, ModeSpeedRanges[mode].Min, ModeSpeedRanges[mode].Max);
+}
+
+// Puts every mode in its slot of the set
+inline void CreateModes(TModeSet& modes) {
+    NRegistry::Create(modes, std::make_index_sequence<ModeCount>());
+}
+
+// Returns ModeCount for an unknown name
+constexpr size_t FindMode(std::string_view name) {
+    for (size_t i = 0; i < ModeInfos.size(); ++i) {
+        if (ModeInfos[i].Name == name) {
+            return i;
+        }
+    }
+    return ModeCount;
+}
@@ -0,0 +1,71 @@
+#include "state_publisher.h"
+
+#include <esp_err.h>
+
+TStatePublisher::TStatePublisher(uint32_t intervalMs, TCallback callback, void* arg)
+    : IntervalMs_(intervalMs)
+    , Callback_(callback)
+    , Arg_(arg)
+    , LastPublishMs_(NowMs() - intervalMs) {
+}
+
+void TStatePublisher::Start() {
+    esp_timer_create_args_t timerArgs{};
+    timerArgs.callback = OnTimer;
+    timerArgs.arg = this;
+    timerArgs.name = "state";
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &Timer_))
+    xTaskCreate(StateTask, "StateTask", 3072, this, 1, &Task_);
+}
+
+void TStatePublisher::Update(size_t channel, bool isOn, size_t mode) {
+    auto state = static_cast<uint16_t>(Valid | (isOn ? On : 0) | mode);
+    if (Pending_[channel].exchange(state) & Valid) {
+        ++Suppressed_;
+    }
+    if (Armed_.exchange(true)) {
+        return;
+    }
+    // Unsigned differences keep working when the milliseconds wrap
+    auto elapsed = NowMs() - LastPublishMs_;
+    auto delayMs = elapsed >= IntervalMs_ ? 0 : IntervalMs_ - elapsed;
+    esp_timer_start_once(Timer_, static_cast<uint64_t>(delayMs) * 1000);
+}
+
+// Runs in the esp_timer task, the states stay in Pending_ until the StateTask takes them
+void TStatePublisher::OnTimer(void* arg) {
+    xTaskNotifyGive(static_cast<TStatePublisher*>(arg)->Task_);
+}
+
+void TStatePublisher::StateTask(void* arg) {
+    auto self = static_cast<TStatePublisher*>(arg);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        self->Publish();
+    }
+}
+
+// While a slow publish holds the task, the newer states only replace the pending ones
+void TStatePublisher::Publish() {
+    // Cleared first, an Update() during the loop arms the timer again instead of being lost
+    Armed_ = false;
+    bool published = false;
+    for (size_t i = 0; i < Pending_.size(); ++i) {
+        auto state = Pending_[i].exchange(0);
+        if ((state & Valid) == 0) {
+            continue;
+        }
+        if (state == Sent_[i]) {
+            ++Suppressed_;
+            continue;
+        }
+        if (Callback_(Arg_, i, (state & On) != 0, static_cast<uint8_t>(state & ~(Valid | On)))) {
+            Sent_[i] = state;
+            ++Published_;
+            published = true;
+        }
+    }
+    if (published) {
+        LastPublishMs_ = NowMs();
+    }
+}
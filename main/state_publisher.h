@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "output.h"
+
+// Publishes the state of the channels at most once per interval. The first change after a quiet
+// interval goes out at once, the changes that come faster are coalesced and only the latest one
+// is published when the interval ends, so the final state is never later than one interval.
+// Update() is called from the OutputTask. The timer only wakes the StateTask, the callback runs
+// there, so a publish that waits for the network doesn't hold the esp_timer task and the frames.
+class TStatePublisher {
+public:
+    // Returns false when the state could not be sent, it is sent again with the next change
+    using TCallback = bool (*)(void* arg, size_t channel, bool isOn, uint8_t mode);
+
+    TStatePublisher(uint32_t intervalMs, TCallback callback, void* arg);
+
+    // Before the first Update()
+    void Start();
+    void Update(size_t channel, bool isOn, size_t mode);
+
+    [[nodiscard]] uint32_t Published() const {
+        return Published_;
+    }
+
+    // The intermediate states that were replaced by a newer one and the repeats of the published one
+    [[nodiscard]] uint32_t Suppressed() const {
+        return Suppressed_;
+    }
+
+private:
+    static void OnTimer(void* arg);
+    [[noreturn]] static void StateTask(void* arg);
+    void Publish();
+
+    // Valid, on and the mode in one word, so a pending state is swapped atomically
+    static constexpr uint16_t Valid = 0x8000;
+    static constexpr uint16_t On = 0x4000;
+
+    static uint32_t NowMs() {
+        return static_cast<uint32_t>(esp_timer_get_time() / 1000);
+    }
+
+private:
+    uint32_t IntervalMs_;
+    TCallback Callback_;
+    void* Arg_;
+    esp_timer_handle_t Timer_ = nullptr;
+    TaskHandle_t Task_ = nullptr;
+    std::array<std::atomic<uint16_t>, OutputChannels> Pending_{};
+    // Touched only in the StateTask
+    std::array<uint16_t, OutputChannels> Sent_{};
+    std::atomic<bool> Armed_{false};
+    std::atomic<uint32_t> LastPublishMs_{0};
+    std::atomic<uint32_t> Published_{0};
+    std::atomic<uint32_t> Suppressed_{0};
+};
@@ -20,6 +20,19 @@ public:
         return {result.begin(), result.end()};
     }
 
+    // Reads into the buffer without an allocation, size is the capacity in and the length out
+    [[nodiscard]] bool Read(std::string_view name, char* buffer, size_t& size) const {
+        return nvs_get_blob(Handle_, name.data(), buffer, &size) == ESP_OK;
+    }
+
+    [[nodiscard]] bool GetInt(std::string_view name, int32_t& value) const {
+        return nvs_get_i32(Handle_, name.data(), &value) == ESP_OK;
+    }
+
+    [[nodiscard]] bool SetInt(std::string_view name, int32_t value) const {
+        return nvs_set_i32(Handle_, name.data(), value) == ESP_OK;
+    }
+
     [[nodiscard]] bool Set(std::string_view name, std::string_view value) const {
         return nvs_set_blob(Handle_, name.data(), value.data(), value.size()) == ESP_OK;
     }
@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Who woke the CPU. Every wake up of a task or a timer costs the time to switch to it, and
+// while any of them is pending the idle task can't put the CPU to sleep.
+enum class EWakeSource : uint8_t {
+    Output,
+    Frame,
+    Led,
+    Button,
+    Count,
+};
+
+using TWakeCounts = std::array<uint32_t, static_cast<size_t>(EWakeSource::Count)>;
+
+inline constexpr std::array<std::string_view, static_cast<size_t>(EWakeSource::Count)> WakeSourceNames = {
+    "output", "frame", "led", "button",
+};
+
+// Counts the wake ups, so the idle power of the builds can be compared
+namespace NWakeups {
+    inline std::array<std::atomic<uint32_t>, static_cast<size_t>(EWakeSource::Count)> Counters{};
+
+    inline void Count(EWakeSource source) {
+        Counters[static_cast<size_t>(source)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Returns the counts since the previous call
+    inline TWakeCounts Take() {
+        TWakeCounts counts{};
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] = Counters[i].exchange(0, std::memory_order_relaxed);
+        }
+        return counts;
+    }
+}
@@ -0,0 +1,36 @@
+#include "ws2812.h"
+
+#include <algorithm>
+#include <driver/i2s.h>
+#include <esp_log.h>
+
+static const char *TAG = "WS2812";
+
+TWs2812Sink::TWs2812Sink(size_t count) : Buffer_(NWs2812::EncodedSize(count) / sizeof(uint16_t)) {
+    i2s_config_t config{};
+    config.mode = static_cast<i2s_mode_t>(I2S_MODE_MASTER | I2S_MODE_TX);
+    // 16-bit stereo, so one sample carries 32 bits of the stream
+    config.sample_rate = NWs2812::BitRate / 32;
+    config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    config.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+    config.communication_format = I2S_COMM_FORMAT_I2S_MSB;
+    // Enough DMA buffers to hold a whole frame of 300 pixels, i2s_write returns before it is sent
+    config.dma_buf_count = 4;
+    config.dma_buf_len = 256;
+    // Zeros are sent when the DMA runs dry, which keeps the line low between the frames
+    config.tx_desc_auto_clear = true;
+    if (i2s_driver_install(I2S_NUM_0, &config, 0, nullptr) != ESP_OK) {
+        ESP_LOGE(TAG, "Can't install i2s driver");
+        return;
+    }
+    i2s_pin_config_t pins{};
+    pins.data_out_en = 1;
+    i2s_set_pin(I2S_NUM_0, &pins);
+}
+
+void TWs2812Sink::Show(const TPixel* frame, size_t count) {
+    count = std::min(count, (Buffer_.size() * sizeof(uint16_t) - NWs2812::ResetBytes) / 12);
+    NWs2812::Encode(frame, count, Buffer_.data());
+    size_t written = 0;
+    i2s_write(I2S_NUM_0, Buffer_.data(), NWs2812::EncodedSize(count), &written, portMAX_DELAY);
+}
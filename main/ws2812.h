@@ -0,0 +1,49 @@
+#pragma once
+#include "pixels.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace NWs2812 {
+    // Every bit of the strip is sent as 4 bits of I2S at 3.2 MHz: 1000 is 0 and 1110 is 1.
+    // The table turns one nibble of the colour into 16 bits of the I2S stream.
+    inline constexpr uint16_t NibblePatterns[16] = {
+        0b1000100010001000, 0b1000100010001110, 0b1000100011101000, 0b1000100011101110,
+        0b1000111010001000, 0b1000111010001110, 0b1000111011101000, 0b1000111011101110,
+        0b1110100010001000, 0b1110100010001110, 0b1110100011101000, 0b1110100011101110,
+        0b1110111010001000, 0b1110111010001110, 0b1110111011101000, 0b1110111011101110,
+    };
+
+    constexpr uint32_t BitRate = 3200000;
+    // Low time that latches the colours, 300 us covers the newer WS2812B
+    constexpr size_t ResetBytes = BitRate / 8 * 300 / 1000000;
+
+    constexpr size_t EncodedSize(size_t pixels) {
+        return pixels * 3 * 4 + ResetBytes;
+    }
+
+    // The I2S shifts out the high half of every 32-bit word first. So the low nibble is stored first
+    // and the high nibble is sent first, MSB first like the WS2812 expects.
+    // The wire order of the colours is G, R, B.
+    inline void Encode(const TPixel* frame, size_t count, uint16_t* out) {
+        for (size_t i = 0; i < count; ++i) {
+            for (uint8_t value : {frame[i].G, frame[i].R, frame[i].B}) {
+                *out++ = NibblePatterns[value & 0x0f];
+                *out++ = NibblePatterns[value >> 4];
+            }
+        }
+        for (size_t i = 0; i < ResetBytes / 2; ++i) {
+            *out++ = 0;
+        }
+    }
+}
+
+// Streams the frames to the strip through the I2S DMA on GPIO3 (RXD0), the CPU only encodes them
+class TWs2812Sink : public IPixelSink {
+public:
+    explicit TWs2812Sink(size_t count);
+    void Show(const TPixel* frame, size_t count) override;
+
+private:
+    std::vector<uint16_t> Buffer_;
+};